@@ -0,0 +1,367 @@
+// Microbenchmarks for the server's core data structures.
+//
+// Usage: ofs_bench [output.json]   (default: standard output)
+//
+// Each benchmark runs with a doubling iteration count until one run takes at
+// least MIN_RUN_TIME, and reports that run as nanoseconds and heap
+// allocations per operation. The filesystem benchmarks build an OFSystem in
+// memory, so no container file is touched. Results are JSON so two builds
+// can be compared run against run.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/json.hpp"
+#include "../include/OFSTypes.h"
+#include "../include/FileSystem.h"
+#include "../include/UserMap.h"
+#include "../include/RequestQueue.h"
+#include "../include/OperationTable.h"
+#include "../include/OperationParams.h"
+#include "../include/Log.h"
+
+using json = nlohmann::json;
+
+// Internal helpers from FileSystem.cpp.
+int find_entry_by_path(OFSystem& fs_instance, const std::string& path, const AccessContext* caller = nullptr);
+int find_free_metadata_entry(OFSystem& fs_instance);
+int find_free_extent(OFSystem& fs_instance, uint32_t block_count);
+
+// ============================================================================
+// ALLOCATION COUNTING
+// ============================================================================
+// Every global operator new lands in one of these two. Each thread counts its
+// own allocations; threads a benchmark starts add theirs to
+// g_thread_allocations before exiting.
+
+static thread_local uint64_t t_allocations = 0;
+static std::atomic<uint64_t> g_thread_allocations{0};
+
+void* operator new(std::size_t size) {
+    ++t_allocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    ++t_allocations;
+    size_t align = (size_t)alignment;
+    if (void* p = std::aligned_alloc(align, (size + align - 1) / align * align)) return p;
+    throw std::bad_alloc();
+}
+
+// Kept out of line: inlined into callers, GCC sees new-expressions paired
+// with free() and warns (-Wmismatched-new-delete).
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+// ============================================================================
+// HARNESS
+// ============================================================================
+
+static const std::chrono::milliseconds MIN_RUN_TIME(200);
+
+// Keeps the compiler from discarding a result it can see is unused.
+template <typename T>
+static void keep(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+static json g_results = json::array();
+
+// `run(iterations)` performs the operation `iterations` times.
+template <typename Run>
+static void measure(const std::string& name, json params, Run&& run) {
+    run(1);   // Warm caches and any lazily built state
+    uint64_t iterations = 1;
+    while (true) {
+        uint64_t allocations_before = t_allocations + g_thread_allocations.load();
+        auto start = std::chrono::steady_clock::now();
+        run(iterations);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        uint64_t allocations = t_allocations + g_thread_allocations.load() - allocations_before;
+
+        if (elapsed >= MIN_RUN_TIME || iterations >= (1ULL << 32)) {
+            double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+            json result = {{"name", name},
+                           {"params", params},
+                           {"iterations", iterations},
+                           {"ns_per_op", ns / iterations},
+                           {"allocs_per_op", (double)allocations / iterations}};
+            std::cerr << name << " " << params.dump() << ": " << result["ns_per_op"].get<double>() << " ns/op, "
+                      << result["allocs_per_op"].get<double>() << " allocs/op" << std::endl;
+            g_results.push_back(std::move(result));
+            return;
+        }
+        iterations *= 2;
+    }
+}
+
+// ============================================================================
+// FILESYSTEM FIXTURES
+// ============================================================================
+// Entry 0 is the root directory. Used entries are packed at the front of the
+// table, the layout first-fit allocation leaves behind.
+
+static MetadataEntry make_entry(uint32_t parent, const std::string& name, bool directory) {
+    MetadataEntry entry{};
+    entry.validity_flag = 0;
+    entry.type_flag = directory ? 1 : 0;
+    entry.parent_index = parent;
+    memcpy(entry.short_name, name.data(), std::min(name.size(), sizeof(entry.short_name) - 1));
+    return entry;
+}
+
+static void reset_table(OFSystem& fs, size_t entries) {
+    fs.metadata_entries.assign(entries, MetadataEntry{});
+    for (MetadataEntry& entry : fs.metadata_entries) entry.validity_flag = 1;
+    fs.metadata_entries[0] = make_entry(0, "/", true);
+}
+
+// `entries` slots, `used` of them taken (the root included): files in the
+// root, then a chain of `depth` - 1 directories ending in the file the
+// lookup resolves. The chain comes after the filler, so every segment scans
+// the filled part.
+static std::string build_path_table(OFSystem& fs, size_t entries, size_t used, size_t depth) {
+    reset_table(fs, entries);
+    char name[24];
+    size_t slot = 1;
+    for (; slot < used - depth; ++slot) {
+        snprintf(name, sizeof(name), "f%05zu", slot);
+        fs.metadata_entries[slot] = make_entry(0, name, false);
+    }
+    std::string path;
+    uint32_t parent = 0;
+    for (size_t level = 1; level <= depth; ++level, ++slot) {
+        bool last = level == depth;
+        snprintf(name, sizeof(name), last ? "target" : "d%zu", level);
+        fs.metadata_entries[slot] = make_entry(parent, name, !last);
+        parent = (uint32_t)slot;
+        path += "/";
+        path += name;
+    }
+    return path;
+}
+
+static void bench_find_entry_by_path() {
+    OFSystem fs;
+    for (size_t entries : {100, 1000, 10000}) {
+        for (int fill_percent : {10, 50, 100}) {
+            for (size_t depth : {1, 4, 8}) {
+                size_t used = std::max(entries * fill_percent / 100, depth + 1);
+                std::string path = build_path_table(fs, entries, used, depth);
+                measure("find_entry_by_path", {{"entries", entries}, {"fill_percent", fill_percent}, {"depth", depth}},
+                        [&](uint64_t iterations) {
+                            for (uint64_t i = 0; i < iterations; ++i) keep(find_entry_by_path(fs, path));
+                        });
+            }
+        }
+    }
+}
+
+static void bench_find_free_metadata_entry() {
+    OFSystem fs;
+    for (size_t entries : {1000, 10000}) {
+        for (int occupancy_percent : {0, 50, 90, 99}) {
+            reset_table(fs, entries);
+            size_t used = entries * occupancy_percent / 100;
+            for (size_t i = 1; i < used; ++i) fs.metadata_entries[i] = make_entry(0, "f", false);
+            measure("find_free_metadata_entry", {{"entries", entries}, {"occupancy_percent", occupancy_percent}},
+                    [&](uint64_t iterations) {
+                        for (uint64_t i = 0; i < iterations; ++i) keep(find_free_metadata_entry(fs));
+                    });
+        }
+    }
+}
+
+// find_free_extent() is this tree's block allocator: first fit over the
+// free map for a run of `blocks`.
+static void bench_find_free_extent() {
+    OFSystem fs;
+    const size_t block_count = 25600;   // 100 MB of 4 KB blocks
+    for (uint32_t blocks : {1u, 16u}) {
+        for (int occupancy_percent : {0, 50, 90, 99}) {
+            fs.free_block_map.assign(block_count, true);
+            fs.free_block_map[0] = false;
+            size_t used = block_count * occupancy_percent / 100;
+            for (size_t i = 1; i < used; ++i) fs.free_block_map[i] = false;
+            measure("find_free_extent", {{"blocks", blocks}, {"total_blocks", block_count}, {"occupancy_percent", occupancy_percent}},
+                    [&](uint64_t iterations) {
+                        for (uint64_t i = 0; i < iterations; ++i) keep(find_free_extent(fs, blocks));
+                    });
+        }
+    }
+}
+
+// ============================================================================
+// USER MAP
+// ============================================================================
+
+static void bench_user_map_get() {
+    for (int users : {50, 1000}) {
+        // Sized like init_filesystem(): one bucket per user slot.
+        UserMap* map = user_map_create(users);
+        std::vector<UserInfo> table(users);
+        std::vector<std::string> names, missing;
+        for (int i = 0; i < users; ++i) {
+            names.push_back("user" + std::to_string(i));
+            missing.push_back("nobody" + std::to_string(i));
+            user_map_insert(map, names.back(), &table[i]);
+        }
+        for (bool hit : {true, false}) {
+            const std::vector<std::string>& keys = hit ? names : missing;
+            measure("user_map_get", {{"users", users}, {"hit", hit}}, [&](uint64_t iterations) {
+                size_t k = 0;
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    keep(user_map_get(map, keys[k]));
+                    if (++k == keys.size()) k = 0;
+                }
+            });
+        }
+        user_map_destroy(map);
+    }
+}
+
+// ============================================================================
+// REQUEST QUEUE
+// ============================================================================
+// Producers stand in for event loops and consumers for workers. ns_per_op is
+// wall time per request from the first push to the last pop, so it falls as
+// the queue scales. A producer that finds the queue full yields and retries.
+
+static void bench_request_queue() {
+    const size_t TENANTS = 16;
+    std::vector<std::string> tenants;
+    for (size_t i = 0; i < TENANTS; ++i) tenants.push_back("tenant" + std::to_string(i));
+
+    for (auto [producers, consumers] : {std::pair<int, int>{1, 1}, {2, 4}, {4, 4}, {8, 4}}) {
+        measure("request_queue_push_pop", {{"producers", producers}, {"consumers", consumers}, {"capacity", 64}},
+                [&](uint64_t iterations) {
+            RequestQueue queue(64);
+            std::atomic<uint64_t> popped{0};
+            auto report = [](uint64_t before) { g_thread_allocations += t_allocations - before; };
+
+            std::vector<std::thread> threads;
+            for (int c = 0; c < consumers; ++c) {
+                threads.emplace_back([&, c] {
+                    uint64_t before = t_allocations;
+                    while (true) {
+                        ClientRequest request = queue.pop();
+                        if (request.client_socket < 0) break;
+                        if (popped.fetch_add(1) + 1 == iterations) {
+                            // Everything is consumed; release the other consumers.
+                            for (int other = 1; other < consumers; ++other) {
+                                ClientRequest stop{};
+                                stop.client_socket = -1;
+                                while (!queue.push(std::move(stop))) std::this_thread::yield();
+                            }
+                            break;
+                        }
+                    }
+                    report(before);
+                });
+            }
+            for (int p = 0; p < producers; ++p) {
+                threads.emplace_back([&, p] {
+                    uint64_t before = t_allocations;
+                    for (uint64_t i = p; i < iterations; i += producers) {
+                        ClientRequest request{};
+                        request.client_socket = 1;
+                        request.priority = (RequestClass)(i % (size_t)RequestClass::Count);
+                        request.tenant = tenants[i % TENANTS];
+                        request.enqueued_at = std::chrono::steady_clock::now();
+                        while (!queue.push(std::move(request))) std::this_thread::yield();
+                    }
+                    report(before);
+                });
+            }
+            for (std::thread& thread : threads) thread.join();
+        });
+    }
+}
+
+// ============================================================================
+// JSON REQUEST DECODE
+// ============================================================================
+// The lock-free half of prepare_operation() in Main.cpp: parse the body, look
+// the operation up and decode its parameters through OperationParams, which
+// normalises paths. Binding the handler is left out, as it needs the server.
+
+template <typename Params>
+static void decode_params(const json& params) {
+    keep(Params::decode(params));
+}
+
+static void bench_json_decode() {
+    const std::string session = "0123456789abcdef0123456789abcdef";
+    struct Case {
+        const char* label;
+        json request;
+        void (*decode)(const json& params);
+    };
+    const std::vector<Case> cases = {
+        {"file_read", {{"operation", "file_read"}, {"session_id", session}, {"parameters", {{"path", "/docs/reports/q3.txt"}}}},
+         decode_params<PathParams>},
+        {"rename_path", {{"operation", "rename_path"}, {"session_id", session},
+                         {"parameters", {{"old_path", "/docs/a.txt"}, {"new_path", "/archive/a.txt"}}}},
+         decode_params<RenameParams>},
+        {"create_file_with_content", {{"operation", "create_file_with_content"}, {"session_id", session},
+                                      {"parameters", {{"path", "/docs/new.txt"}, {"data", std::string(4096, 'x')}}}},
+         decode_params<ContentParams>},
+    };
+
+    for (const Case& c : cases) {
+        const std::string body = c.request.dump();
+        measure("json_request_decode", {{"operation", c.label}, {"bytes", body.size()}}, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                json req = json::parse(body);
+                keep(find_operation(req["operation"].get_ref<const std::string&>()));
+                keep(session_id_of(req));
+                c.decode(parameters_of(req));
+            }
+        });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    g_log_level = (uint8_t)LogLevel::Off;
+
+    bench_find_entry_by_path();
+    bench_find_free_metadata_entry();
+    bench_find_free_extent();
+    bench_user_map_get();
+    bench_request_queue();
+    bench_json_decode();
+
+    char date[32];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+#ifdef __OPTIMIZE__
+    const bool optimized = true;
+#else
+    const bool optimized = false;
+#endif
+    json report = {{"compiler", __VERSION__}, {"optimized", optimized}, {"date", date}, {"benchmarks", g_results}};
+
+    if (argc > 1) {
+        std::ofstream out(argv[1]);
+        if (!out) { std::cerr << "Cannot write " << argv[1] << std::endl; return 1; }
+        out << report.dump(2) << std::endl;
+    } else {
+        std::cout << report.dump(2) << std::endl;
+    }
+    return 0;
+}
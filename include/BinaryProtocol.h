@@ -0,0 +1,101 @@
+#ifndef BINARY_PROTOCOL_H
+#define BINARY_PROTOCOL_H
+
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+
+// Compact binary protocol served on ServerConfig::binary_port.
+//
+// Every frame starts with a 12-byte header, all integers big-endian:
+//
+//   u16 magic ("OB")  u8 version  u8 opcode/status  u32 request_id  u32 body_length
+//
+// In a request the fourth byte is the opcode, in a response it is the status
+// (0 = success). request_id is echoed back unchanged. Body fields are either
+// fixed-width integers or a u32 length followed by raw bytes, so file content
+// travels unescaped. Every request except LOGIN begins with the session id.
+//
+// Error body: i32 error_code, bytes message, u32 retry_after_ms.
+
+const uint16_t BINARY_MAGIC = 0x4F42;  // "OB"
+const uint8_t BINARY_VERSION = 1;
+const size_t BINARY_HEADER_SIZE = 12;
+
+enum BinaryOpcode : uint8_t {
+    BIN_OP_LOGIN          = 0x01,  // username, password -> session_id, u8 is_admin
+    BIN_OP_LOGOUT         = 0x02,
+    BIN_OP_FILE_CREATE    = 0x10,  // path, content
+    BIN_OP_FILE_READ      = 0x11,  // path -> content
+    BIN_OP_FILE_EDIT      = 0x12,  // path, u32 index, content
+    BIN_OP_FILE_TRUNCATE  = 0x13,  // path
+    BIN_OP_FILE_DELETE    = 0x14,  // path
+    BIN_OP_DIR_CREATE     = 0x20,  // path
+    BIN_OP_DIR_LIST       = 0x21,  // path -> u32 count, {u8 is_directory, name}*
+    BIN_OP_DIR_DELETE     = 0x22,  // path
+    BIN_OP_RENAME         = 0x30,  // old_path, new_path
+    BIN_OP_STAT           = 0x31,  // path -> name, u8 is_dir, u64 size, u32 owner, u32 perms, u64 created, u64 modified
+    BIN_OP_FS_STATS       = 0x40   // -> u64 total, u64 used, u64 free, u32 files, u32 dirs
+};
+
+enum BinaryStatus : uint8_t {
+    BIN_STATUS_OK    = 0,
+    BIN_STATUS_ERROR = 1
+};
+
+struct BinaryHeader {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t code;         // Opcode in requests, status in responses
+    uint32_t request_id;
+    uint32_t body_length;
+};
+
+// Thrown when a body ends before all of an opcode's fields were read.
+class BinaryDecodeError : public std::runtime_error {
+public:
+    explicit BinaryDecodeError(const std::string& msg) : std::runtime_error(msg) {}
+};
+
+// Reads fields sequentially from a body without copying it.
+class BinaryReader {
+public:
+    BinaryReader(const char* data, size_t size) : m_data(data), m_size(size), m_offset(0) {}
+
+    uint8_t read_u8();
+    uint32_t read_u32();
+    uint64_t read_u64();
+    std::string read_bytes();
+
+private:
+    void require(size_t count) const;
+
+    const char* m_data;
+    size_t m_size;
+    size_t m_offset;
+};
+
+// Builds a response frame; the header is patched in by finish().
+class BinaryWriter {
+public:
+    BinaryWriter() : m_buffer(BINARY_HEADER_SIZE, '\0') {}
+
+    void write_u8(uint8_t value);
+    void write_u32(uint32_t value);
+    void write_u64(uint64_t value);
+    void write_bytes(const std::string& value);
+    // trailing_bytes: body bytes the caller sends after the frame (sendfile).
+    std::string finish(uint8_t status, uint32_t request_id, uint64_t trailing_bytes = 0);
+
+private:
+    std::string m_buffer;
+};
+
+// Parses and validates a header. Returns false if magic or version is wrong.
+bool decode_binary_header(const char* data, BinaryHeader& header);
+std::string encode_binary_error(uint32_t request_id, int32_t error_code, const std::string& message, uint32_t retry_after_ms = 0);
+// JSON operation name an opcode corresponds to, for rate limiting and lock
+// selection. nullptr for unknown opcodes.
+const char* binary_operation_name(uint8_t opcode);
+
+#endif // BINARY_PROTOCOL_H
@@ -0,0 +1,59 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <string>
+#include <cstdint>
+#include "Server.h"
+#include "Log.h"
+
+// Settings read from a .uconf file (see compiled/default.uconf). Every field
+// has a built-in default, so a missing file or key keeps today's behaviour.
+//
+// [filesystem] values shape the container and only take effect when it is
+// formatted; an existing .omni keeps the geometry recorded in its header.
+// The other sections are read on every start.
+
+struct FilesystemConfig {
+    std::string container = "my_ofs.omni";
+    uint64_t total_size = 100 * 1024 * 1024;
+    uint64_t block_size = 4096;
+    uint32_t max_files = 1000;           // Metadata entries, including the root
+    uint32_t max_filename_length = 11;   // Enforced on create and rename; capped by MetadataEntry::short_name
+};
+
+struct SecurityConfig {
+    uint32_t max_users = 50;
+    std::string admin_username = "admin";
+    std::string admin_password = "admin123";
+};
+
+struct IoConfig {
+    bool use_io_uring = true;
+    uint32_t queue_depth = 256;          // io_uring submission queue entries
+    uint32_t resume_threads = 4;         // Threads that resume coroutines after I/O
+};
+
+struct OFSConfig {
+    FilesystemConfig filesystem;
+    SecurityConfig security;
+    IoConfig io;
+    LogConfig log;
+    int http_port = 8080;                // [server] port: the HTTP API and web UI
+    ServerConfig server;                 // Raw socket front end
+
+    std::string source;                  // Path the settings came from, empty for defaults
+    std::string hash;                    // SHA-256 of the file's bytes, lowercase hex
+};
+
+// Parses an INI-style file: [section] headers, `key = value` lines, values
+// optionally in double quotes, and comments starting with '#' or ';' either
+// on their own line or after a value. Unknown keys are reported and ignored.
+// Returns false, with `error` naming the line, on a malformed line or a
+// value that is not a valid number/boolean or is out of range. A missing
+// file is not an error: `config` keeps its defaults.
+bool load_config(const std::string& path, OFSConfig& config, std::string& error);
+
+// Lowercase hex SHA-256 of `data` (64 characters).
+std::string sha256_hex(const std::string& data);
+
+#endif // CONFIG_H
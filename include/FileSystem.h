@@ -4,30 +4,79 @@
 #include <vector>
 #include <string>
 #include "OFSTypes.h"
+#include "Task.h"
+#include "Config.h"
 
-void format_filesystem(const std::string& filepath);
-void init_filesystem(OFSystem& fs_instance, const std::string& filepath);
-void shutdown_filesystem();
+void format_filesystem(const std::string& filepath, const OFSConfig& config);
+void init_filesystem(OFSystem& fs_instance, const std::string& filepath, const OFSConfig& config);
+void shutdown_filesystem(OFSystem& fs_instance);
+void save_session_snapshot(OFSystem& fs_instance);
+void restore_session_snapshot(OFSystem& fs_instance);
+ActiveSession* find_active_session(OFSystem& fs_instance, const std::string& session_id);
 std::string login_user(OFSystem& fs_instance, const std::string& username, const std::string& password);
 void logout_user(OFSystem& fs_instance, const std::string& session_id);
 void create_user(OFSystem& fs_instance, const std::string& username, const std::string& password, uint32_t role);
+std::vector<int32_t> create_users_batch(OFSystem& fs_instance, const std::vector<NewUserRequest>& requests);
 void delete_user(OFSystem& fs_instance, const std::string& username);
 std::vector<std::string> list_all_users(OFSystem& fs_instance);
 SessionInfo get_session_details(OFSystem& fs_instance, const std::string& session_id);
-void create_directory(OFSystem& fs_instance, const std::string& path);
-std::vector<DirEntryInfo> list_directory_contents(OFSystem& fs_instance, const std::string& path);
-void remove_directory(OFSystem& fs_instance, const std::string& path);
-bool path_is_directory(OFSystem& fs_instance, const std::string& path);
-void create_file_with_content(OFSystem& fs_instance, const std::string& path, const std::string& content);
-std::string read_file_content(OFSystem& fs_instance, const std::string& path);
-void remove_file(OFSystem& fs_instance, const std::string& path);
-void edit_file(OFSystem& fs_instance, const std::string& path, const std::string& new_content, uint32_t index);
-void truncate_file_content(OFSystem& fs_instance, const std::string& path);
-bool path_is_file(OFSystem& fs_instance, const std::string& path);
-void rename_path(OFSystem& fs_instance, const std::string& old_path, const std::string& new_path);
+void create_directory(OFSystem& fs_instance, const std::string& path, const AccessContext& caller = SYSTEM_ACCESS);
+std::vector<DirEntryInfo> list_directory_contents(OFSystem& fs_instance, const std::string& path, const AccessContext& caller = SYSTEM_ACCESS);
+void remove_directory(OFSystem& fs_instance, const std::string& path, const AccessContext& caller = SYSTEM_ACCESS);
+bool path_is_directory(OFSystem& fs_instance, const std::string& path, const AccessContext& caller = SYSTEM_ACCESS);
+void create_file_with_content(OFSystem& fs_instance, const std::string& path, const std::string& content, const AccessContext& caller = SYSTEM_ACCESS);
+std::string read_file_content(OFSystem& fs_instance, const std::string& path, const AccessContext& caller = SYSTEM_ACCESS);
+void remove_file(OFSystem& fs_instance, const std::string& path, const AccessContext& caller = SYSTEM_ACCESS);
+void edit_file(OFSystem& fs_instance, const std::string& path, const std::string& new_content, uint32_t index, const AccessContext& caller = SYSTEM_ACCESS);
+void truncate_file_content(OFSystem& fs_instance, const std::string& path, const AccessContext& caller = SYSTEM_ACCESS);
+bool path_is_file(OFSystem& fs_instance, const std::string& path, const AccessContext& caller = SYSTEM_ACCESS);
+void rename_path(OFSystem& fs_instance, const std::string& old_path, const std::string& new_path, const AccessContext& caller = SYSTEM_ACCESS);
 FSStats get_fs_stats(OFSystem& fs_instance);
-FileMetadata get_path_metadata(OFSystem& fs_instance, const std::string& path);
-void set_path_permissions(OFSystem& fs_instance, const std::string& path, uint32_t permissions);
+FileMetadata get_path_metadata(OFSystem& fs_instance, const std::string& path, const AccessContext& caller = SYSTEM_ACCESS);
+void set_path_permissions(OFSystem& fs_instance, const std::string& path, uint32_t permissions, const AccessContext& caller = SYSTEM_ACCESS);
+void begin_file_upload(OFSystem& fs_instance, const std::string& path, uint64_t size, FileUpload& upload, const AccessContext& caller = SYSTEM_ACCESS);
+bool write_file_upload(OFSystem& fs_instance, FileUpload& upload, const char* data, size_t length);
+void finish_file_upload(OFSystem& fs_instance, FileUpload& upload);
+void abort_file_upload(OFSystem& fs_instance, FileUpload& upload);
+void begin_file_download(OFSystem& fs_instance, const std::string& path, FileDownload& download, const AccessContext& caller = SYSTEM_ACCESS);
+size_t read_file_download(OFSystem& fs_instance, FileDownload& download, uint64_t offset, char* buffer, size_t length);
+void begin_file_edit(OFSystem& fs_instance, const std::string& path, uint32_t index, size_t length, FileEdit& edit, const AccessContext& caller = SYSTEM_ACCESS);
+void finish_file_edit(OFSystem& fs_instance, FileEdit& edit);
+void abort_file_edit(OFSystem& fs_instance, FileEdit& edit);
+FileExtent pin_file_extent(OFSystem& fs_instance, const std::string& path, const AccessContext& caller = SYSTEM_ACCESS);
+void unpin_file_extent(OFSystem& fs_instance, uint32_t start_block);
+uint32_t user_id_of(OFSystem& fs_instance, const UserInfo* user);
+UserQuota get_user_quota(const UserInfo& user);
+void set_user_quota(OFSystem& fs_instance, const std::string& username, const UserQuota& quota);
+UserUsage get_user_usage(OFSystem& fs_instance, uint32_t user_id);
+void begin_metadata_batch(OFSystem& fs_instance);
+void end_metadata_batch(OFSystem& fs_instance);
 std::string get_error_string(int error_code);
 
+// Awaitable container I/O for coroutine handlers. A coroutine holds no lock
+// across these: it runs the begin_* step under its locks, awaits the transfer
+// with none held, then runs the finish_* step. The synchronous functions
+// above are the same steps with the transfer done inline.
+task<bool> container_io_async(OFSystem& fs_instance, bool is_write, uint64_t offset, char* buffer, size_t length);
+task<bool> write_file_upload_async(OFSystem& fs_instance, FileUpload& upload, const char* data, size_t length);
+
+// Canonical form of a client path: rooted, no empty segments, no trailing
+// slash. Needs no filesystem state, so callers run it before taking locks.
+// Throws OFS_ERROR_INVALID_PATH for a name that does not fit an entry.
+std::string normalize_path(const std::string& path);
+
+// Holds a pin_file_extent() pin and drops it on scope exit, so a throw or a
+// failed transfer between pin and unpin cannot leave the blocks pinned.
+class ExtentPin {
+public:
+    ExtentPin(OFSystem& fs_instance, const FileExtent& extent) : m_fs(fs_instance), m_start_block(extent.start_block) {}
+    ~ExtentPin() { unpin_file_extent(m_fs, m_start_block); }
+    ExtentPin(const ExtentPin&) = delete;
+    ExtentPin& operator=(const ExtentPin&) = delete;
+
+private:
+    OFSystem& m_fs;
+    uint32_t m_start_block;
+};
+
 #endif // FILESYSTEM_H
\ No newline at end of file
@@ -0,0 +1,134 @@
+#ifndef IO_BACKEND_H
+#define IO_BACKEND_H
+
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <deque>
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+
+// One positioned read or write against the container.
+struct IoRequest {
+    bool is_write;
+    int fd;
+    uint64_t offset;
+    char* buffer;           // Source for writes, destination for reads
+    size_t length;
+    ssize_t result;         // Bytes transferred, or -errno
+
+    static IoRequest read(int fd, uint64_t offset, char* buffer, size_t length) {
+        return {false, fd, offset, buffer, length, 0};
+    }
+    static IoRequest write(int fd, uint64_t offset, const char* buffer, size_t length) {
+        return {true, fd, offset, const_cast<char*>(buffer), length, 0};
+    }
+};
+
+// Data-block I/O for the container. On kernels with io_uring, requests from
+// every calling thread are collected by one submitter thread, handed to the
+// kernel together in a single io_uring_enter() and completed as the kernel
+// finishes them, so a multi-block read and other workers' I/O are all in
+// flight at once. The ring is driven through raw syscalls; no liburing is
+// needed. Without io_uring (old kernel, seccomp), requests run synchronously
+// with pread/pwrite on the calling thread.
+//
+// Coroutines co_await transfer() instead of blocking: the calling thread is
+// free as soon as the requests are queued, and the coroutine continues on
+// one of a few resume threads once the last of them completes. Those threads
+// only run continuations; code on them must never block in submit_and_wait()
+// or sync_wait().
+class IoBackend {
+public:
+    // queue_depth sizes the ring (the kernel rounds it up to a power of two);
+    // resume_threads is how many threads run coroutine continuations.
+    explicit IoBackend(bool try_io_uring = true, unsigned queue_depth = 256, unsigned resume_threads = 4);
+    ~IoBackend();
+    IoBackend(const IoBackend&) = delete;
+    IoBackend& operator=(const IoBackend&) = delete;
+
+    // Runs every request and returns once all have completed. Short transfers
+    // are continued until the full length is done, EOF or an error.
+    void submit_and_wait(IoRequest* requests, size_t count);
+
+    // Awaitable form of submit_and_wait(). Without io_uring the requests run
+    // synchronously in await_ready() and the coroutine never suspends.
+    struct Transfer {
+        IoBackend& backend;
+        IoRequest* requests;
+        size_t count;
+
+        bool await_ready() {
+            if (backend.uses_io_uring() && count > 0) return false;
+            backend.submit_and_wait(requests, count);
+            return true;
+        }
+        void await_suspend(std::coroutine_handle<> continuation) { backend.submit_async(requests, count, continuation); }
+        void await_resume() {}
+    };
+    Transfer transfer(IoRequest* requests, size_t count) { return {*this, requests, count}; }
+
+    bool uses_io_uring() const { return m_ring_fd >= 0; }
+
+private:
+    struct Batch;
+    struct Pending {
+        IoRequest* request;
+        Batch* batch;
+        size_t done;        // Bytes already transferred
+    };
+
+    bool setup_ring(unsigned queue_depth);
+    void teardown_ring();
+    void submitter_loop();
+    bool queue_sqe(Pending* pending);
+    void arm_wakeup();
+    int enter(unsigned to_submit, unsigned min_complete);
+    static void run_sync(IoRequest& request);
+    void submit_async(IoRequest* requests, size_t count, std::coroutine_handle<> continuation);
+    void enqueue(Batch& batch, IoRequest* requests, size_t count);
+    void resume_loop();
+
+    int m_ring_fd = -1;
+    int m_wake_fd = -1;
+    unsigned m_sq_entries = 0;
+
+    // Ring memory shared with the kernel.
+    void* m_sq_ring = nullptr;
+    void* m_cq_ring = nullptr;
+    size_t m_sq_ring_size = 0;
+    size_t m_cq_ring_size = 0;
+    struct io_uring_sqe* m_sqes = nullptr;
+    unsigned* m_sq_head = nullptr;
+    unsigned* m_sq_tail = nullptr;
+    unsigned* m_sq_mask = nullptr;
+    unsigned* m_sq_array = nullptr;
+    unsigned* m_cq_head = nullptr;
+    unsigned* m_cq_tail = nullptr;
+    unsigned* m_cq_mask = nullptr;
+    struct io_uring_cqe* m_cqes = nullptr;
+
+    // Handed from callers to the submitter; guarded by m_mutex.
+    std::mutex m_mutex;
+    std::vector<Pending*> m_incoming;
+    bool m_stopping = false;
+
+    // Submitter-thread state.
+    std::deque<Pending*> m_backlog;   // Waiting for a free SQE
+    unsigned m_in_flight = 0;
+    uint64_t m_wake_value = 0;        // Target of the eventfd read
+    std::thread m_submitter;
+
+    // Continuations of finished async batches, run by m_resumers.
+    std::mutex m_ready_mutex;
+    std::condition_variable m_ready_cv;
+    std::deque<std::coroutine_handle<>> m_ready;
+    bool m_resumers_stopping = false;
+    std::vector<std::thread> m_resumers;
+};
+
+#endif // IO_BACKEND_H
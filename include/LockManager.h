@@ -0,0 +1,52 @@
+#ifndef LOCK_MANAGER_H
+#define LOCK_MANAGER_H
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+
+// Striped lock table keyed by metadata entry index, plus the two short
+// critical sections shared by every operation:
+//
+//   stripe locks    -> namespace lock -> allocator lock
+//
+// Locks are always taken left to right. Stripes protect an entry's contents
+// (data blocks, size, timestamps) for the duration of an operation. The
+// namespace lock guards the fields path resolution reads (validity, parent,
+// name, owner, permissions, size) and is only held for in-memory work. The
+// allocator lock covers the free block map, free metadata slots and quota
+// counters.
+class LockManager {
+public:
+    static const uint32_t STRIPE_COUNT = 64;
+
+    // Releases every stripe it holds when destroyed.
+    class Guard {
+    public:
+        Guard(std::vector<std::shared_mutex*> locked, bool exclusive);
+        Guard(Guard&& other) noexcept;
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        ~Guard();
+
+    private:
+        std::vector<std::shared_mutex*> m_locked;
+        bool m_exclusive;
+    };
+
+    // Locks the stripes covering `entries`. Callers list entries parent first;
+    // the stripes are then acquired in ascending stripe order, a single global
+    // order, so two operations can never wait on each other in a cycle.
+    Guard lock_entries(const std::vector<uint32_t>& entries, bool exclusive);
+
+    std::shared_mutex& namespace_lock() { return m_namespace; }
+    std::mutex& allocator_lock() { return m_allocator; }
+
+private:
+    std::shared_mutex m_stripes[STRIPE_COUNT];
+    std::shared_mutex m_namespace;
+    std::mutex m_allocator;
+};
+
+#endif // LOCK_MANAGER_H
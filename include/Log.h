@@ -0,0 +1,101 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <atomic>
+#include <type_traits>
+
+// Structured, asynchronous logging. A record is a message plus key=value
+// fields, written in logfmt:
+//
+//   ts=2026-01-01T12:00:00.000123Z level=info thread=2 msg="Login failed" user=bob
+//
+// Each thread formats its records into its own lock-free ring buffer; one
+// writer thread drains every ring, orders the batch by timestamp and writes
+// it to the log file with a single write(). A caller never blocks on output,
+// so logging under g_fs_mutex is cheap. When a ring is full the record is
+// dropped and counted, and the writer reports the count.
+//
+//   LOG_INFO("Created user").kv("user", username).kv("slot", free_slot);
+//
+// The level check happens before any argument is evaluated, so a disabled
+// level costs one relaxed load and a branch. Levels below OFS_LOG_MIN_LEVEL
+// are removed at compile time.
+
+enum class LogLevel : uint8_t { Debug, Info, Warn, Error, Off };
+
+#ifndef OFS_LOG_MIN_LEVEL
+#define OFS_LOG_MIN_LEVEL 0   // LogLevel value; 1 compiles out Debug
+#endif
+
+struct LogConfig {
+    std::string file;                    // Empty: standard error
+    LogLevel level = LogLevel::Info;
+};
+
+// "debug", "info", "warn", "error" or "off".
+bool parse_log_level(const std::string& text, LogLevel& out);
+
+extern std::atomic<uint8_t> g_log_level;
+
+inline bool log_enabled(LogLevel level) {
+#if OFS_LOG_MIN_LEVEL > 0
+    if ((uint8_t)level < OFS_LOG_MIN_LEVEL) return false;
+#endif
+    return (uint8_t)level >= g_log_level.load(std::memory_order_relaxed);
+}
+
+// Opens the destination and starts the writer thread. Records logged before
+// this wait in their rings. Returns false with `error` set if the file cannot
+// be opened.
+bool log_start(const LogConfig& config, std::string& error);
+
+// Stops the writer after a final drain of every ring. Call once, at exit.
+void log_stop();
+
+// One record, built on the stack and pushed to the calling thread's ring when
+// it goes out of scope. Create it through the LOG_* macros.
+class LogRecord {
+public:
+    LogRecord(LogLevel level, std::string_view message);
+    ~LogRecord();
+    LogRecord(const LogRecord&) = delete;
+    LogRecord& operator=(const LogRecord&) = delete;
+
+    LogRecord& kv(const char* key, std::string_view value);
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    LogRecord& kv(const char* key, T value) {
+        if constexpr (std::is_same_v<T, bool>) return kv(key, std::string_view(value ? "true" : "false"));
+        else if constexpr (std::is_signed_v<T>) return kv_signed(key, (long long)value);
+        else return kv_unsigned(key, (unsigned long long)value);
+    }
+
+private:
+    LogRecord& kv_signed(const char* key, long long value);
+    LogRecord& kv_unsigned(const char* key, unsigned long long value);
+    void append(std::string_view text);
+    void append_value(std::string_view value);
+
+    static const size_t MAX_TEXT = 1024;   // Longer records are truncated
+    LogLevel m_level;
+    uint32_t m_length = 0;
+    char m_text[MAX_TEXT];
+};
+
+// Lets the macros below discard the record expression in a conditional.
+struct LogVoidify {
+    void operator&(const LogRecord&) {}
+};
+
+#define OFS_LOG(level, message) \
+    !log_enabled(level) ? (void)0 : LogVoidify() & LogRecord(level, message)
+
+#define LOG_DEBUG(message) OFS_LOG(LogLevel::Debug, message)
+#define LOG_INFO(message)  OFS_LOG(LogLevel::Info, message)
+#define LOG_WARN(message)  OFS_LOG(LogLevel::Warn, message)
+#define LOG_ERROR(message) OFS_LOG(LogLevel::Error, message)
+
+#endif // LOG_H
@@ -0,0 +1,62 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <cstdint>
+#include <chrono>
+#include "OperationTable.h"
+
+// Where a request's time goes, in the order a socket request meets them.
+enum class Stage : uint8_t {
+    QueueWait,      // Enqueued by an event loop until a worker picks it up
+    LockWait,       // Waiting for g_fs_mutex
+    Execute,        // Session lookup and the FileSystem call, under the lock
+    Io,             // Container transfers awaited by coroutine handlers
+    Serialize,      // Building the response (JSON document or binary frame)
+    Count
+};
+
+inline uint64_t monotonic_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Stage times of one request, summed while it runs and recorded once at the
+// end. A stage the request never entered is not recorded.
+struct StageTimes {
+    uint64_t ns[(size_t)Stage::Count] = {};
+    uint8_t seen = 0;   // Bit per Stage
+
+    void add(Stage stage, uint64_t elapsed) {
+        ns[(size_t)stage] += elapsed;
+        seen |= (uint8_t)(1u << (size_t)stage);
+    }
+};
+
+// Adds the time between construction and destruction to one stage.
+class StageClock {
+public:
+    StageClock(StageTimes& times, Stage stage) : m_times(times), m_stage(stage), m_start(monotonic_ns()) {}
+    ~StageClock() { m_times.add(m_stage, monotonic_ns() - m_start); }
+    StageClock(const StageClock&) = delete;
+    StageClock& operator=(const StageClock&) = delete;
+
+private:
+    StageTimes& m_times;
+    Stage m_stage;
+    uint64_t m_start;
+};
+
+// Latency histograms per (operation, stage). Each thread records into its
+// own shard without locks or shared cache lines; a scrape merges the shards.
+// Buckets are log-linear like HdrHistogram's: 8 per power of two, so any
+// reported quantile is within 12.5% of the true value, from 1 ns to ~18 min.
+void record_latency(OperationId op, Stage stage, uint64_t nanoseconds);
+void record_stages(OperationId op, const StageTimes& times);
+
+// The histograms as Prometheus summaries (p50/p90/p99/p999 per operation and
+// stage) followed by the socket server's counters and gauges, in the text
+// exposition format served at /metrics.
+std::string render_metrics();
+
+#endif // METRICS_H
@@ -5,11 +5,41 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <fstream>
+#include <stdexcept>
 
 // FORWARD DECLARATION to break the include cycle.
 // OFSystem only needs to know that UserMap is a type it can have a pointer to.
 // The full details of UserMap are not needed here.
 struct UserMap;
+class LockManager;
+class IoBackend;
+
+// --- Error Codes ---
+// Values mirror OFSErrorCodes in source/include/odf_types.hpp so clients can
+// interpret them the same way for every backend.
+enum OFSResult : int32_t {
+    OFS_SUCCESS = 0,
+    OFS_ERROR_NOT_FOUND = -1,
+    OFS_ERROR_PERMISSION_DENIED = -2,
+    OFS_ERROR_IO_ERROR = -3,
+    OFS_ERROR_INVALID_PATH = -4,
+    OFS_ERROR_FILE_EXISTS = -5,
+    OFS_ERROR_NO_SPACE = -6,
+    OFS_ERROR_INVALID_CONFIG = -7,
+    OFS_ERROR_NOT_IMPLEMENTED = -8,
+    OFS_ERROR_INVALID_SESSION = -9,
+    OFS_ERROR_DIRECTORY_NOT_EMPTY = -10,
+    OFS_ERROR_INVALID_OPERATION = -11
+};
+
+// Thrown by file system functions for failures the client must be told about.
+// The API layer turns it into an error response carrying `code`.
+struct OFSException : public std::runtime_error {
+    int32_t code;
+    OFSException(int32_t error_code, const std::string& message)
+        : std::runtime_error(message), code(error_code) {}
+};
 
 // --- On-Disk Data Structures ---
 struct OMNIHeader {
@@ -26,7 +56,10 @@ struct OMNIHeader {
     uint32_t max_users;
     uint32_t file_state_storage_offset;
     uint32_t change_log_offset;
-    uint8_t reserved[328];
+    uint32_t metadata_count;    // Metadata entries; 0 in containers formatted before it was stored (1000)
+    uint8_t clean_unmount;      // 1 after a graceful shutdown saved the free map; cleared on load
+    uint8_t max_filename_length; // Longest name a create may use; 0 in containers formatted before it was stored
+    uint8_t reserved[322];
 };
 
 struct UserInfo {
@@ -36,7 +69,7 @@ struct UserInfo {
     uint64_t created_time;
     uint64_t last_login;
     uint8_t is_active;
-    uint8_t reserved[23];
+    uint8_t reserved[23];   // bytes 0-7: quota bytes, 8-11: quota inodes (0 = unlimited)
 };
 
 struct MetadataEntry {
@@ -82,14 +115,132 @@ struct SessionInfo {
     uint32_t role;
 };
 
+struct NewUserRequest {
+    std::string username;
+    std::string password;
+    uint32_t role;
+};
+
+// Quota limits persisted in UserInfo::reserved. Zero means unlimited.
+struct UserQuota {
+    uint64_t max_bytes;
+    uint32_t max_inodes;
+};
+
+// Running consumption per user slot, kept in step with every create/remove so
+// quota checks never need to scan the metadata table.
+struct UserUsage {
+    uint64_t bytes_used;
+    uint32_t inode_count;
+};
+
+// Handles for streaming transfers. An upload owns a reserved entry and extent
+// until finish_file_upload or abort_file_upload; a download holds a snapshot
+// of the entry that every chunk is checked against.
+struct FileUpload {
+    uint32_t entry_index;
+    uint32_t parent_index;
+    MetadataEntry entry;
+    uint64_t written;
+};
+
+struct FileDownload {
+    uint32_t entry_index;
+    MetadataEntry entry;
+    uint64_t generation;     // OFSystem::entry_generations[entry_index] at the start
+};
+
+// An in-place edit whose bytes go to `position` in the container. The file's
+// extent is pinned from begin_file_edit until finish_file_edit or
+// abort_file_edit.
+struct FileEdit {
+    uint32_t entry_index;
+    MetadataEntry entry;
+    uint64_t generation;     // OFSystem::entry_generations[entry_index] at the start
+    uint64_t position;
+};
+
+// A pinned file's bytes inside the container, for sending straight from disk
+// (sendfile). The extent stays allocated until unpin_file_extent(start_block).
+struct FileExtent {
+    int fd;
+    uint64_t offset;
+    uint64_t length;
+    uint32_t start_block;
+};
+
+// Permission bits as tested against MetadataEntry::permissions (UNIX layout,
+// see FilePermissions in odf_types.hpp). Owner bits sit 6 above the "others" bits.
+const uint32_t PERM_READ = 04;
+const uint32_t PERM_WRITE = 02;
+const uint32_t PERM_EXECUTE = 01;
+const uint32_t PERM_OWNER_SHIFT = 6;
+const uint32_t DEFAULT_DIR_PERMISSIONS = 0755;
+const uint32_t DEFAULT_FILE_PERMISSIONS = 0644;
+const uint32_t DEFAULT_ROOT_PERMISSIONS = 0777; // Root is shared by every user
+
+// Caller identity, computed once at login and carried by the session so that
+// permission checks are a single mask test per path component.
+struct AccessContext {
+    uint32_t uid;   // User slot, compared against MetadataEntry::owner_id
+    uint32_t role;  // 1 = admin, bypasses permission bits
+};
+
+// Internal callers (format, init, batch tooling) act as the admin slot.
+const AccessContext SYSTEM_ACCESS = {0, 1};
+
+const uint64_t SESSION_TTL_SECONDS = 8 * 60 * 60;
+
+struct ActiveSession {
+    UserInfo* user;
+    AccessContext access;
+    uint64_t login_time;
+    uint64_t expires_at;
+};
+
+// On-disk record in the warm-restart session snapshot (<omni file>.sessions).
+struct SessionSnapshotRecord {
+    char session_id[32];        // Not NUL-terminated when the id fills it
+    uint32_t uid;
+    uint64_t login_time;
+    uint64_t expires_at;
+    // Identify the account in slot `uid` when saved, so a slot that was
+    // reused in between does not hand the session to someone else.
+    char username[32];
+    uint64_t user_created_time;
+};
+
 struct OFSystem {
     OMNIHeader header;
     std::vector<UserInfo> user_table;
     UserMap* user_map; // This pointer is now valid because of the forward declaration
-    std::map<std::string, UserInfo*> active_sessions;
+    std::map<std::string, ActiveSession> active_sessions;
+    LockManager* lock_manager;     // Per-entry stripes plus namespace/allocator locks
     std::vector<MetadataEntry> metadata_entries;
+    // Set from next_entry_generation each time a slot is given to a new file
+    // or directory, so a download or edit can tell its file from one created
+    // later in the same slot (created_time has one-second resolution). Kept
+    // in memory only, as no handle outlives the process. Guarded by the
+    // namespace lock.
+    std::vector<uint64_t> entry_generations;
+    uint64_t next_entry_generation = 0;
     std::vector<bool> free_block_map;
+    std::vector<UserUsage> user_usage; // Indexed by user slot (== MetadataEntry::owner_id)
     std::string omni_filepath;
+    // While a metadata batch is open, persist_metadata_entry() only records the
+    // entry here and end_metadata_batch() writes them all in one pass. Only
+    // used under an exclusive g_fs_mutex.
+    bool metadata_batch_open = false;
+    std::map<uint32_t, MetadataEntry> pending_metadata;
+    // Descriptor of the container for data-block I/O through io_backend and
+    // for zero-copy sends.
+    int omni_fd = -1;
+    IoBackend* io_backend = nullptr;
+    // Extents being sent straight from disk, keyed by start block. Frees of a
+    // pinned extent are parked in deferred_extent_frees as (start, count)
+    // until the last pin goes. Guarded by the allocator lock.
+    std::map<uint32_t, uint32_t> extent_pins;
+    std::multimap<uint32_t, std::pair<uint32_t, uint32_t>> deferred_extent_frees;
 };
 
 #endif // OFS_TYPES_H
\ No newline at end of file
@@ -0,0 +1,105 @@
+#ifndef OPERATION_PARAMS_H
+#define OPERATION_PARAMS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "json.hpp"
+#include "OFSTypes.h"
+
+// Parameter decoding for JSON operations. Each operation's parameters are
+// read out of the request once, into the struct its handler takes, before any
+// lock is held. Missing or mistyped fields become OFS errors; paths are
+// normalised here too. Touches no filesystem state, so the benchmarks link it
+// on its own.
+
+// Clients may send "session_id": null before logging in.
+std::string session_id_of(const nlohmann::json& req);
+
+// The request's "parameters" object, or an empty object if it has none.
+const nlohmann::json& parameters_of(const nlohmann::json& req);
+
+const nlohmann::json& required_param(const nlohmann::json& params, const char* key);
+std::string string_param(const nlohmann::json& params, const char* key);
+std::string path_param(const nlohmann::json& params, const char* key);
+
+template <typename T>
+T number_param(const nlohmann::json& params, const char* key) {
+    const nlohmann::json& value = required_param(params, key);
+    if (!value.is_number()) throw OFSException(OFS_ERROR_INVALID_OPERATION, std::string("Parameter '") + key + "' must be a number");
+    return value.get<T>();
+}
+
+template <typename T>
+T optional_number_param(const nlohmann::json& params, const char* key, T fallback) {
+    return params.contains(key) ? number_param<T>(params, key) : fallback;
+}
+
+struct NoParams {
+    static NoParams decode(const nlohmann::json&) { return {}; }
+};
+
+struct PathParams {
+    std::string path;
+    static PathParams decode(const nlohmann::json& p) { return {path_param(p, "path")}; }
+};
+
+struct LoginParams {
+    std::string username, password;
+    static LoginParams decode(const nlohmann::json& p) { return {string_param(p, "username"), string_param(p, "password")}; }
+};
+
+struct UsernameParams {
+    std::string username;
+    static UsernameParams decode(const nlohmann::json& p) { return {string_param(p, "username")}; }
+};
+
+struct NewUserParams {
+    NewUserRequest user;
+    static NewUserParams decode(const nlohmann::json& p) {
+        return {{string_param(p, "username"), string_param(p, "password"), optional_number_param<uint32_t>(p, "role", 0)}};
+    }
+};
+
+struct UserBatchParams {
+    std::vector<NewUserRequest> users;
+    static UserBatchParams decode(const nlohmann::json& p);
+};
+
+struct SetQuotaParams {
+    std::string username;
+    UserQuota quota;
+    static SetQuotaParams decode(const nlohmann::json& p) {
+        return {string_param(p, "username"),
+                {optional_number_param<uint64_t>(p, "max_bytes", 0), optional_number_param<uint32_t>(p, "max_files", 0)}};
+    }
+};
+
+struct QuotaQueryParams {
+    std::string username;  // Empty: the caller
+    static QuotaQueryParams decode(const nlohmann::json& p) { return {p.contains("username") ? string_param(p, "username") : ""}; }
+};
+
+struct ContentParams {
+    std::string path, data;
+    static ContentParams decode(const nlohmann::json& p) { return {path_param(p, "path"), string_param(p, "data")}; }
+};
+
+struct EditParams {
+    std::string path, data;
+    uint32_t index;
+    static EditParams decode(const nlohmann::json& p) { return {path_param(p, "path"), string_param(p, "data"), number_param<uint32_t>(p, "index")}; }
+};
+
+struct RenameParams {
+    std::string old_path, new_path;
+    static RenameParams decode(const nlohmann::json& p) { return {path_param(p, "old_path"), path_param(p, "new_path")}; }
+};
+
+struct PermissionParams {
+    std::string path;
+    uint32_t permissions;
+    static PermissionParams decode(const nlohmann::json& p) { return {path_param(p, "path"), number_param<uint32_t>(p, "permissions")}; }
+};
+
+#endif // OPERATION_PARAMS_H
@@ -0,0 +1,142 @@
+#ifndef OPERATION_TABLE_H
+#define OPERATION_TABLE_H
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Every JSON operation the server understands, in the order of OPERATIONS.
+enum class OperationId : uint8_t {
+    UserLogin,
+    UserLogout,
+    UserList,
+    UserCreate,
+    UserCreateBatch,
+    UserDelete,
+    UserSetQuota,
+    GetUserQuota,
+    FsShutdown,
+    GetServerStats,
+    GetFsStats,
+    ListDirectoryContents,
+    DirCreate,
+    RemoveDirectory,
+    CreateFileWithContent,
+    FileRead,
+    EditFile,
+    TruncateFileContent,
+    RemoveFile,
+    RenamePath,
+    GetPathMetadata,
+    SetPathPermissions,
+    Count
+};
+
+enum OperationFlags : uint8_t {
+    OP_READ       = 1 << 0,  // Only reads state; charged to the read budget
+    OP_ACCOUNT    = 1 << 1,  // Touches users or sessions; takes g_fs_mutex exclusively
+    OP_ADMIN      = 1 << 2,  // Requires an admin session
+    OP_NO_SESSION = 1 << 3,  // Runs without a session (login)
+    OP_BULK       = 1 << 4   // Moves file content; scheduled as RequestClass::Bulk
+};
+
+struct OperationInfo {
+    std::string_view name;
+    OperationId id;
+    uint8_t flags;
+};
+
+constexpr OperationInfo OPERATIONS[] = {
+    {"user_login",               OperationId::UserLogin,             OP_ACCOUNT | OP_NO_SESSION},
+    {"user_logout",              OperationId::UserLogout,            OP_ACCOUNT},
+    {"user_list",                OperationId::UserList,              OP_READ | OP_ADMIN},
+    {"user_create",              OperationId::UserCreate,            OP_ACCOUNT | OP_ADMIN},
+    {"user_create_batch",        OperationId::UserCreateBatch,       OP_ACCOUNT | OP_ADMIN},
+    {"user_delete",              OperationId::UserDelete,            OP_ACCOUNT | OP_ADMIN},
+    {"user_set_quota",           OperationId::UserSetQuota,          OP_ACCOUNT | OP_ADMIN},
+    {"get_user_quota",           OperationId::GetUserQuota,          OP_READ},
+    {"fs_shutdown",              OperationId::FsShutdown,            OP_ACCOUNT | OP_ADMIN},
+    {"get_server_stats",         OperationId::GetServerStats,        OP_READ},
+    {"get_fs_stats",             OperationId::GetFsStats,            OP_READ},
+    {"list_directory_contents",  OperationId::ListDirectoryContents, OP_READ},
+    {"dir_create",               OperationId::DirCreate,             0},
+    {"remove_directory",         OperationId::RemoveDirectory,       0},
+    {"create_file_with_content", OperationId::CreateFileWithContent, OP_BULK},
+    {"file_read",                OperationId::FileRead,              OP_READ | OP_BULK},
+    {"edit_file",                OperationId::EditFile,              OP_BULK},
+    {"truncate_file_content",    OperationId::TruncateFileContent,   0},
+    {"remove_file",              OperationId::RemoveFile,            0},
+    {"rename_path",              OperationId::RenamePath,            0},
+    {"get_path_metadata",        OperationId::GetPathMetadata,       OP_READ},
+    {"set_path_permissions",     OperationId::SetPathPermissions,    0},
+};
+
+const size_t OPERATION_COUNT = sizeof(OPERATIONS) / sizeof(OPERATIONS[0]);
+static_assert(OPERATION_COUNT == (size_t)OperationId::Count, "OPERATIONS must list every OperationId");
+
+constexpr bool operations_in_order() {
+    for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+        if ((size_t)OPERATIONS[i].id != i) return false;
+    }
+    return true;
+}
+static_assert(operations_in_order(), "OPERATIONS must be in OperationId order");
+
+// Name lookup is a perfect hash: the compiler searches for a seed under which
+// FNV-1a sends every name to its own slot, so a lookup is one hash, one slot
+// read and one string compare however many operations there are.
+const unsigned OPERATION_SLOT_BITS = 6;
+const size_t OPERATION_SLOT_COUNT = size_t(1) << OPERATION_SLOT_BITS;
+static_assert(OPERATION_COUNT < OPERATION_SLOT_COUNT, "Grow OPERATION_SLOT_COUNT");
+
+constexpr uint32_t operation_hash(std::string_view name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (char c : name) {
+        hash ^= (uint8_t)c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// The top bits: FNV's low bits depend only on the low bits of its input.
+constexpr size_t operation_slot(std::string_view name, uint32_t seed) {
+    return operation_hash(name, seed) >> (32 - OPERATION_SLOT_BITS);
+}
+
+constexpr uint32_t find_operation_seed() {
+    for (uint32_t seed = 0;; ++seed) {
+        bool used[OPERATION_SLOT_COUNT] = {};
+        bool collision = false;
+        for (size_t i = 0; i < OPERATION_COUNT && !collision; ++i) {
+            size_t slot = operation_slot(OPERATIONS[i].name, seed);
+            collision = used[slot];
+            used[slot] = true;
+        }
+        if (!collision) return seed;
+    }
+}
+
+constexpr uint32_t OPERATION_SEED = find_operation_seed();
+
+// Slot -> index into OPERATIONS plus one; 0 marks an empty slot.
+constexpr std::array<uint8_t, OPERATION_SLOT_COUNT> build_operation_slots() {
+    std::array<uint8_t, OPERATION_SLOT_COUNT> slots = {};
+    for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+        slots[operation_slot(OPERATIONS[i].name, OPERATION_SEED)] = (uint8_t)(i + 1);
+    }
+    return slots;
+}
+
+constexpr std::array<uint8_t, OPERATION_SLOT_COUNT> OPERATION_SLOTS = build_operation_slots();
+
+// Returns nullptr for names that are not operations.
+constexpr const OperationInfo* find_operation(std::string_view name) {
+    uint8_t entry = OPERATION_SLOTS[operation_slot(name, OPERATION_SEED)];
+    if (entry == 0 || OPERATIONS[entry - 1].name != name) return nullptr;
+    return &OPERATIONS[entry - 1];
+}
+
+static_assert(find_operation("file_read") == &OPERATIONS[(size_t)OperationId::FileRead], "Perfect hash lookup is broken");
+static_assert(find_operation("no_such_operation") == nullptr, "Perfect hash lookup is broken");
+
+#endif // OPERATION_TABLE_H
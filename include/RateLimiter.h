@@ -0,0 +1,57 @@
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <string>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+
+// Burst size and sustained rate for one class of operation.
+struct RateLimitPolicy {
+    double capacity;
+    double refill_per_second;
+};
+
+struct TokenBucket {
+    double tokens;
+    std::chrono::steady_clock::time_point last_refill;
+};
+
+// Per-key token buckets with separate budgets for cheap reads and heavy
+// writes. Keys are spread over independently locked shards so concurrent
+// requests from different clients rarely contend.
+class RateLimiter {
+public:
+    RateLimiter(RateLimitPolicy read_policy, RateLimitPolicy write_policy);
+
+    // Takes one token from the key's bucket. Returns 0 when admitted,
+    // otherwise the number of milliseconds until a token will be available.
+    long try_acquire(const std::string& key, bool is_write);
+
+    // Gives back a token taken by try_acquire when a later check rejected the request.
+    void refund(const std::string& key, bool is_write);
+
+private:
+    static const int SHARD_COUNT = 16;
+    static const size_t PRUNE_THRESHOLD = 4096;
+
+    struct BucketPair {
+        TokenBucket read;
+        TokenBucket write;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, BucketPair> buckets;
+    };
+
+    Shard& shard_for(const std::string& key);
+    void refill(TokenBucket& bucket, const RateLimitPolicy& policy, std::chrono::steady_clock::time_point now);
+    void prune(Shard& shard, std::chrono::steady_clock::time_point now);
+
+    RateLimitPolicy m_read_policy;
+    RateLimitPolicy m_write_policy;
+    Shard m_shards[SHARD_COUNT];
+};
+
+#endif // RATE_LIMITER_H
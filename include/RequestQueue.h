@@ -2,24 +2,133 @@
 #define REQUEST_QUEUE_H
 
 #include <string>
-#include <queue>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <cstdint>
 #include <mutex>
-#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include "OperationTable.h"
+
+// Scheduling classes, most latency-sensitive first. The event loop assigns
+// one to each request from its operation (see classify_request in Server.cpp).
+enum class RequestClass : uint8_t {
+    Interactive,    // Metadata, listings, logins: small and latency-bound
+    Admin,          // Operations that need an admin session
+    Bulk,           // Operations that move file content
+    Count
+};
+
+// Share of worker time each class receives while all of them have work
+// waiting; an idle class's share goes to the others.
+const uint32_t REQUEST_CLASS_WEIGHTS[(size_t)RequestClass::Count] = {8, 4, 1};
 
 struct ClientRequest {
     int client_socket;
     std::string request_data;
+    std::string remote_addr;
+    std::chrono::steady_clock::time_point enqueued_at;
+    int loop_id;                // Event loop that owns the connection
+    uint64_t connection_id;     // Guards against the fd being reused before the reply
+    bool binary;                // request_data is a BinaryProtocol frame, not JSON
+    RequestClass priority = RequestClass::Interactive;
+    uint32_t cost = 1;          // Estimated work, in units of a small metadata request
+    std::string tenant;         // Fairness key: the client address
+    OperationId operation = OperationId::Count;  // Count when the name is unknown
 };
 
+// Bounded request queue with weighted fair scheduling.
+//
+// Producers (the event loops) push into a lock-free multi-producer ring
+// (Vyukov's design): each slot carries a sequence number that tells
+// producers and consumers whose turn it is, so a push is a single CAS with
+// no shared mutex. Requests are moved in and out, never copied.
+//
+// Workers move what has arrived into per-flow FIFOs under a mutex and take
+// the next request by start-time fair queuing. The consumer side is
+// therefore no longer lock-free: every pop takes m_schedule_mutex for a few
+// heap operations. Picking by virtual time needs one view of every flow's
+// head, so sharding the flows would still leave one serialised pick.
+// request_queue_push_pop measures the cost. With one producer and one
+// consumer it went from 876 to 1323 ns/op against the plain ring, and with
+// four workers it stayed within noise of it (1-CPU host, -O2). Requests
+// take milliseconds, so the pick is not the bottleneck. A flow is one tenant's
+// requests in one class. Each request is tagged on arrival with
+//     start = max(virtual time, flow's previous finish)
+//     finish = start + cost / class weight
+// and the request with the smallest start tag runs next, which advances the
+// virtual time to that tag. A tenant queueing a large upload therefore only
+// delays its own later requests, while other tenants' metadata calls keep
+// their place; within a tenant the weights put metadata ahead of bulk data.
+//
+// push() refuses new work once `capacity` requests are waiting instead of
+// growing, which is what lets the server shed load when workers fall behind.
+// pop() spins briefly and then parks on a futex until a producer signals.
 class RequestQueue {
 public:
-    void push(ClientRequest request);
+    explicit RequestQueue(size_t capacity);  // Rounded up to a power of two
+    RequestQueue(const RequestQueue&) = delete;
+    RequestQueue& operator=(const RequestQueue&) = delete;
+
+    bool push(ClientRequest&& request);
+    bool try_pop(ClientRequest& request);
     ClientRequest pop();
+    size_t size() const;
 
 private:
-    std::queue<ClientRequest> m_queue;
-    std::mutex m_mutex;
-    std::condition_variable m_cond;
+    struct alignas(64) Slot {
+        std::atomic<size_t> sequence;
+        ClientRequest value;
+    };
+
+    struct Tagged {
+        ClientRequest request;
+        double start;
+        double finish;
+    };
+
+    struct Flow {
+        std::deque<Tagged> waiting;
+        double last_finish = 0;
+    };
+
+    // A flow with work, keyed by its head's start tag; `order` breaks ties
+    // in arrival order.
+    struct Ready {
+        double start;
+        uint64_t order;
+        Flow* flow;
+        bool operator>(const Ready& other) const {
+            return start != other.start ? start > other.start : order > other.order;
+        }
+    };
+
+    static const int SPIN_ATTEMPTS = 128;
+    static const size_t FLOW_PRUNE_THRESHOLD = 1024;
+
+    void wake_consumer();
+    bool pop_arrival(ClientRequest& request);
+    void schedule(ClientRequest&& request);
+    void prune_flows();
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_mask;
+    alignas(64) std::atomic<size_t> m_enqueue_pos;
+    alignas(64) std::atomic<size_t> m_dequeue_pos;
+    alignas(64) std::atomic<uint32_t> m_futex_word;  // Bumped whenever a parked consumer must re-check
+    std::atomic<uint32_t> m_sleepers;
+
+    // Scheduler state, guarded by m_schedule_mutex.
+    size_t m_capacity;
+    alignas(64) std::atomic<size_t> m_scheduled;   // Requests moved out of the ring, not yet popped
+    std::mutex m_schedule_mutex;
+    std::unordered_map<std::string, Flow> m_flows;  // Keyed by class and tenant
+    std::priority_queue<Ready, std::vector<Ready>, std::greater<Ready>> m_ready;
+    double m_virtual_time = 0;
+    uint64_t m_arrivals = 0;
 };
 
-#endif // REQUEST_QUEUE_H
\ No newline at end of file
+#endif // REQUEST_QUEUE_H
@@ -0,0 +1,73 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <chrono>
+#include "json.hpp"
+#include "Task.h"
+
+// Raw TCP front end settings. Defaults mirror compiled/default.uconf.
+struct ServerConfig {
+    int port = 8081;                 // [server] socket_port; HTTP/UI is [server] port
+    int binary_port = 8082;          // [server] binary_port: BinaryProtocol.h, 0 = off
+    int max_connections = 20000;     // [server] max_connections
+    int queue_timeout_seconds = 30;  // [server] queue_timeout
+    int worker_count = 4;            // [server] workers
+    size_t queue_capacity = 64;      // [server] queue_capacity
+    int event_loops = 0;             // [server] event_loops: 0 = one epoll loop per core
+    size_t max_request_bytes = 1 << 20;  // [server] max_request_bytes
+    int drain_timeout_seconds = 10;  // [server] drain_timeout: shutdown wait for queued requests
+};
+
+// Counters for the acceptor -> queue -> worker pipeline. Updated lock-free by
+// every stage and read by the get_server_stats operation.
+struct ServerMetrics {
+    std::atomic<uint64_t> accepted{0};
+    std::atomic<uint64_t> active_connections{0};
+    std::atomic<uint64_t> rejected_connections{0};  // over max_connections
+    std::atomic<uint64_t> rejected_queue_full{0};
+    std::atomic<uint64_t> timed_out{0};             // waited longer than queue_timeout
+    std::atomic<uint64_t> processed{0};
+    std::atomic<uint64_t> total_wait_us{0};
+    std::atomic<uint64_t> max_wait_us{0};
+    std::atomic<uint64_t> queue_depth{0};
+    std::atomic<uint64_t> in_flight{0};             // queued or running, reply not yet handed back
+};
+
+extern ServerMetrics g_server_metrics;
+
+// Bytes of the container file that the event loop sends with sendfile() right
+// after the reply's own bytes. release() runs once they are on the wire or the
+// connection is gone.
+struct FileSegment {
+    int fd = -1;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    std::function<void()> release;
+};
+
+void start_server(const ServerConfig& config);
+
+// Stops the socket server for a graceful shutdown: listeners close, new
+// requests on open connections are refused, and requests already queued or
+// running get up to `deadline` to finish and hand their replies to their
+// connections. Returns false if some were still outstanding at the deadline.
+bool stop_server(std::chrono::milliseconds deadline);
+
+// Serialises a JSON reply. File content travels as a JSON string, so bytes
+// that are not valid UTF-8 are replaced with U+FFFD rather than making dump()
+// throw and losing the whole reply.
+inline std::string response_text(const nlohmann::json& response) {
+    return response.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+}
+
+// Implemented in Main.cpp and shared by every front end.
+long check_rate_limit(const std::string& remote_addr, const nlohmann::json& req);
+nlohmann::json execute_request(const nlohmann::json& req);
+task<nlohmann::json> execute_request_async(nlohmann::json req);
+std::string execute_binary_request(const std::string& frame, const std::string& remote_addr, FileSegment& segment);
+
+#endif // SERVER_H
@@ -0,0 +1,183 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+
+// Minimal C++20 coroutine types for request execution.
+//
+//   task<T>       Lazily started coroutine producing a T. Awaiting it starts
+//                 it; when it finishes it resumes the awaiter directly
+//                 (symmetric transfer), on whichever thread finished it.
+//   sync_wait(t)  Runs a task to completion from ordinary code, blocking the
+//                 calling thread. Never call it from a coroutine.
+//   spawn(t)      Starts a task<void> and lets it run on its own; the frame
+//                 frees itself when done.
+//
+// A coroutine that suspends may resume on another thread, so it must not
+// hold a std::mutex or std::shared_mutex across a co_await. Keep co_await out
+// of if/while conditions too: GCC 12 can skip the whole coroutine body for
+// `if (co_await ...)`. Await into a local and test that.
+
+template <typename T>
+class task;
+
+namespace task_detail {
+
+struct promise_base {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+            std::coroutine_handle<> next = h.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    final_awaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { error = std::current_exception(); }
+};
+
+template <typename T>
+struct promise : promise_base {
+    std::optional<T> value;
+    task<T> get_return_object();
+    template <typename U>
+    void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+    T result() {
+        if (error) std::rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+template <>
+struct promise<void> : promise_base {
+    task<void> get_return_object();
+    void return_void() {}
+    void result() {
+        if (error) std::rethrow_exception(error);
+    }
+};
+
+}  // namespace task_detail
+
+template <typename T = void>
+class task {
+public:
+    typedef task_detail::promise<T> promise_type;
+
+    explicit task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+    task(task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+    ~task() { if (m_handle) m_handle.destroy(); }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        m_handle.promise().continuation = awaiter;
+        return m_handle;
+    }
+    T await_resume() { return m_handle.promise().result(); }
+
+private:
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+namespace task_detail {
+
+template <typename T>
+task<T> promise<T>::get_return_object() {
+    return task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+}
+
+inline task<void> promise<void>::get_return_object() {
+    return task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+}
+
+// Eagerly started, self-destroying coroutine used by spawn() and sync_wait().
+struct detached {
+    struct promise_type {
+        detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+struct completion_signal {
+    std::mutex mutex;
+    std::condition_variable done;
+    bool finished = false;
+
+    void notify() {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        done.notify_one();
+    }
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return finished; });
+    }
+};
+
+template <typename T>
+detached run_and_signal(task<T>& t, std::optional<T>& value, std::exception_ptr& error, completion_signal& signal) {
+    try {
+        value.emplace(co_await t);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    signal.notify();
+}
+
+inline detached run_and_signal(task<void>& t, std::exception_ptr& error, completion_signal& signal) {
+    try {
+        co_await t;
+    } catch (...) {
+        error = std::current_exception();
+    }
+    signal.notify();
+}
+
+inline detached run_detached(task<void> t) {
+    co_await t;
+}
+
+}  // namespace task_detail
+
+template <typename T>
+T sync_wait(task<T> t) {
+    std::optional<T> value;
+    std::exception_ptr error;
+    task_detail::completion_signal signal;
+    task_detail::run_and_signal(t, value, error, signal);
+    signal.wait();
+    if (error) std::rethrow_exception(error);
+    return std::move(*value);
+}
+
+inline void sync_wait(task<void> t) {
+    std::exception_ptr error;
+    task_detail::completion_signal signal;
+    task_detail::run_and_signal(t, error, signal);
+    signal.wait();
+    if (error) std::rethrow_exception(error);
+}
+
+// The task must handle its own exceptions; one escaping terminates.
+inline void spawn(task<void> t) {
+    task_detail::run_detached(std::move(t));
+}
+
+#endif // TASK_H
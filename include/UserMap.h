@@ -24,5 +24,6 @@ UserMap* user_map_create(int size);
 void user_map_destroy(UserMap* map);
 void user_map_insert(UserMap* map, const std::string& key, UserInfo* value);
 UserInfo* user_map_get(UserMap* map, const std::string& key);
+void user_map_remove(UserMap* map, const std::string& key);
 
 #endif // USER_MAP_H
\ No newline at end of file
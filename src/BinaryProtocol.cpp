@@ -0,0 +1,106 @@
+#include "../include/BinaryProtocol.h"
+
+static uint32_t load_u32(const char* data) {
+    const unsigned char* p = (const unsigned char*)data;
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void store_u32(char* data, uint32_t value) {
+    data[0] = (char)(value >> 24); data[1] = (char)(value >> 16);
+    data[2] = (char)(value >> 8);  data[3] = (char)value;
+}
+
+void BinaryReader::require(size_t count) const {
+    if (m_size - m_offset < count) throw BinaryDecodeError("Truncated request body");
+}
+
+uint8_t BinaryReader::read_u8() {
+    require(1);
+    return (uint8_t)m_data[m_offset++];
+}
+
+uint32_t BinaryReader::read_u32() {
+    require(4);
+    uint32_t value = load_u32(m_data + m_offset);
+    m_offset += 4;
+    return value;
+}
+
+uint64_t BinaryReader::read_u64() {
+    uint64_t high = read_u32();
+    return (high << 32) | read_u32();
+}
+
+std::string BinaryReader::read_bytes() {
+    uint32_t length = read_u32();
+    require(length);
+    std::string value(m_data + m_offset, length);
+    m_offset += length;
+    return value;
+}
+
+void BinaryWriter::write_u8(uint8_t value) {
+    m_buffer.push_back((char)value);
+}
+
+void BinaryWriter::write_u32(uint32_t value) {
+    char bytes[4];
+    store_u32(bytes, value);
+    m_buffer.append(bytes, 4);
+}
+
+void BinaryWriter::write_u64(uint64_t value) {
+    write_u32((uint32_t)(value >> 32));
+    write_u32((uint32_t)value);
+}
+
+void BinaryWriter::write_bytes(const std::string& value) {
+    write_u32((uint32_t)value.size());
+    m_buffer += value;
+}
+
+std::string BinaryWriter::finish(uint8_t status, uint32_t request_id, uint64_t trailing_bytes) {
+    m_buffer[0] = (char)(BINARY_MAGIC >> 8);
+    m_buffer[1] = (char)(BINARY_MAGIC & 0xFF);
+    m_buffer[2] = (char)BINARY_VERSION;
+    m_buffer[3] = (char)status;
+    store_u32(&m_buffer[4], request_id);
+    store_u32(&m_buffer[8], (uint32_t)(m_buffer.size() - BINARY_HEADER_SIZE + trailing_bytes));
+    return std::move(m_buffer);
+}
+
+bool decode_binary_header(const char* data, BinaryHeader& header) {
+    header.magic = (uint16_t)(((unsigned char)data[0] << 8) | (unsigned char)data[1]);
+    header.version = (uint8_t)data[2];
+    header.code = (uint8_t)data[3];
+    header.request_id = load_u32(data + 4);
+    header.body_length = load_u32(data + 8);
+    return header.magic == BINARY_MAGIC && header.version == BINARY_VERSION;
+}
+
+std::string encode_binary_error(uint32_t request_id, int32_t error_code, const std::string& message, uint32_t retry_after_ms) {
+    BinaryWriter writer;
+    writer.write_u32((uint32_t)error_code);
+    writer.write_bytes(message);
+    writer.write_u32(retry_after_ms);
+    return writer.finish(BIN_STATUS_ERROR, request_id);
+}
+
+const char* binary_operation_name(uint8_t opcode) {
+    switch (opcode) {
+        case BIN_OP_LOGIN:         return "user_login";
+        case BIN_OP_LOGOUT:        return "user_logout";
+        case BIN_OP_FILE_CREATE:   return "create_file_with_content";
+        case BIN_OP_FILE_READ:     return "file_read";
+        case BIN_OP_FILE_EDIT:     return "edit_file";
+        case BIN_OP_FILE_TRUNCATE: return "truncate_file_content";
+        case BIN_OP_FILE_DELETE:   return "remove_file";
+        case BIN_OP_DIR_CREATE:    return "dir_create";
+        case BIN_OP_DIR_LIST:      return "list_directory_contents";
+        case BIN_OP_DIR_DELETE:    return "remove_directory";
+        case BIN_OP_RENAME:        return "rename_path";
+        case BIN_OP_STAT:          return "get_path_metadata";
+        case BIN_OP_FS_STATS:      return "get_fs_stats";
+        default:                   return nullptr;
+    }
+}
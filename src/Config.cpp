@@ -0,0 +1,324 @@
+#include "../include/Config.h"
+#include "../include/OFSTypes.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+
+// ============================================================================
+// SHA-256 (FIPS 180-4), used only to fingerprint the config file
+// ============================================================================
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+static void sha256_block(uint32_t state[8], const unsigned char* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+std::string sha256_hex(const std::string& data) {
+    uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                         0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    const unsigned char* bytes = (const unsigned char*)data.data();
+    size_t full = data.size() / 64 * 64;
+    for (size_t i = 0; i < full; i += 64) sha256_block(state, bytes + i);
+
+    // Tail: remaining bytes, 0x80, zero padding, then the bit length.
+    unsigned char tail[128] = {};
+    size_t rest = data.size() - full;
+    memcpy(tail, bytes + full, rest);
+    tail[rest] = 0x80;
+    size_t tail_size = rest < 56 ? 64 : 128;
+    uint64_t bits = (uint64_t)data.size() * 8;
+    for (int i = 0; i < 8; ++i) tail[tail_size - 1 - i] = (unsigned char)(bits >> (i * 8));
+    for (size_t i = 0; i < tail_size; i += 64) sha256_block(state, tail + i);
+
+    static const char HEX[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(64);
+    for (uint32_t word : state) {
+        for (int shift = 28; shift >= 0; shift -= 4) hex += HEX[(word >> shift) & 0xF];
+    }
+    return hex;
+}
+
+// ============================================================================
+// PARSING
+// ============================================================================
+
+static std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) return "";
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+// Drops a trailing '#' or ';' comment that is not inside double quotes.
+static std::string strip_comment(const std::string& line) {
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        if (line[i] == '"') quoted = !quoted;
+        else if (!quoted && (line[i] == '#' || line[i] == ';')) return line.substr(0, i);
+    }
+    return line;
+}
+
+// Decimal only, so zero-padded values such as `010` mean ten, not eight.
+static bool parse_uint(const std::string& text, uint64_t min, uint64_t max, uint64_t& out) {
+    if (text.empty() || text.size() > 19) return false;
+    uint64_t value = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') return false;
+        value = value * 10 + (uint64_t)(c - '0');
+    }
+    if (value < min || value > max) return false;
+    out = value;
+    return true;
+}
+
+static bool parse_bool(const std::string& text, bool& out) {
+    if (text == "true" || text == "yes" || text == "on" || text == "1") { out = true; return true; }
+    if (text == "false" || text == "no" || text == "off" || text == "0") { out = false; return true; }
+    return false;
+}
+
+// Applies one key. Returns false with `error` set when the value is invalid;
+// sets `known` to false for keys this build does not understand.
+static bool apply_setting(OFSConfig& config, const std::string& section, const std::string& key,
+                          const std::string& value, bool& known, std::string& error) {
+    known = true;
+    uint64_t number = 0;
+    auto number_in = [&](uint64_t min, uint64_t max) {
+        if (parse_uint(value, min, max, number)) return true;
+        error = "'" + key + "' must be a whole number between " + std::to_string(min) + " and " + std::to_string(max);
+        return false;
+    };
+    auto flag = [&](bool& out) {
+        if (parse_bool(value, out)) return true;
+        error = "'" + key + "' must be true or false";
+        return false;
+    };
+
+    if (section == "filesystem") {
+        FilesystemConfig& fs = config.filesystem;
+        if (key == "container") {
+            if (value.empty()) { error = "'container' must not be empty"; return false; }
+            fs.container = value;
+        } else if (key == "total_size") {
+            if (!number_in(1 << 20, 1ULL << 40)) return false;
+            fs.total_size = number;
+        } else if (key == "block_size") {
+            if (!number_in(512, 1 << 20)) return false;
+            if (number & (number - 1)) { error = "'block_size' must be a power of two"; return false; }
+            fs.block_size = number;
+        } else if (key == "max_files") {
+            if (!number_in(2, 1 << 20)) return false;
+            fs.max_files = (uint32_t)number;
+        } else if (key == "max_filename_length") {
+            if (!number_in(1, sizeof(MetadataEntry::short_name) - 1)) return false;
+            fs.max_filename_length = (uint32_t)number;
+        } else if (key == "header_size") {
+            if (!number_in(0, 1 << 20)) return false;
+            if (number != sizeof(OMNIHeader)) {
+                std::cerr << "Config warning: header_size is fixed at " << sizeof(OMNIHeader)
+                          << " bytes by this build; ignoring " << number << std::endl;
+            }
+        } else {
+            known = false;
+        }
+    } else if (section == "security") {
+        SecurityConfig& security = config.security;
+        if (key == "max_users") {
+            if (!number_in(1, 1 << 16)) return false;
+            security.max_users = (uint32_t)number;
+        } else if (key == "admin_username") {
+            if (value.empty() || value.size() >= sizeof(UserInfo::username)) {
+                error = "'admin_username' must be 1-" + std::to_string(sizeof(UserInfo::username) - 1) + " characters";
+                return false;
+            }
+            security.admin_username = value;
+        } else if (key == "admin_password") {
+            if (value.empty() || value.size() >= sizeof(UserInfo::password_hash)) {
+                error = "'admin_password' must be 1-" + std::to_string(sizeof(UserInfo::password_hash) - 1) + " characters";
+                return false;
+            }
+            security.admin_password = value;
+        } else if (key == "require_auth") {
+            bool require = true;
+            if (!flag(require)) return false;
+            if (!require) std::cerr << "Config warning: require_auth = false is not supported; sessions stay required" << std::endl;
+        } else {
+            known = false;
+        }
+    } else if (section == "server") {
+        ServerConfig& server = config.server;
+        if (key == "port") {
+            if (!number_in(1, 65535)) return false;
+            config.http_port = (int)number;
+        } else if (key == "socket_port") {
+            if (!number_in(1, 65535)) return false;
+            server.port = (int)number;
+        } else if (key == "binary_port") {
+            if (!number_in(0, 65535)) return false;
+            server.binary_port = (int)number;
+        } else if (key == "max_connections") {
+            if (!number_in(1, 1 << 20)) return false;
+            server.max_connections = (int)number;
+        } else if (key == "queue_timeout") {
+            if (!number_in(1, 3600)) return false;
+            server.queue_timeout_seconds = (int)number;
+        } else if (key == "workers") {
+            if (!number_in(1, 256)) return false;
+            server.worker_count = (int)number;
+        } else if (key == "queue_capacity") {
+            if (!number_in(1, 1 << 20)) return false;
+            server.queue_capacity = (size_t)number;
+        } else if (key == "event_loops") {
+            if (!number_in(0, 256)) return false;
+            server.event_loops = (int)number;
+        } else if (key == "drain_timeout") {
+            if (!number_in(0, 3600)) return false;
+            server.drain_timeout_seconds = (int)number;
+        } else if (key == "max_request_bytes") {
+            if (!number_in(4096, 1ULL << 30)) return false;
+            server.max_request_bytes = (size_t)number;
+        } else {
+            known = false;
+        }
+    } else if (section == "io") {
+        IoConfig& io = config.io;
+        if (key == "io_uring") {
+            if (!flag(io.use_io_uring)) return false;
+        } else if (key == "queue_depth") {
+            if (!number_in(4, 4096)) return false;
+            io.queue_depth = (uint32_t)number;
+        } else if (key == "resume_threads") {
+            if (!number_in(1, 64)) return false;
+            io.resume_threads = (uint32_t)number;
+        } else {
+            known = false;
+        }
+    } else if (section == "log") {
+        if (key == "file") {
+            config.log.file = value;
+        } else if (key == "level") {
+            if (!parse_log_level(value, config.log.level)) {
+                error = "'level' must be debug, info, warn, error or off";
+                return false;
+            }
+        } else {
+            known = false;
+        }
+    } else {
+        known = false;
+    }
+    return true;
+}
+
+// Checks that need more than one key.
+static bool validate(const OFSConfig& config, std::string& error) {
+    const FilesystemConfig& fs = config.filesystem;
+    uint64_t tables = sizeof(OMNIHeader) + (uint64_t)config.security.max_users * sizeof(UserInfo) +
+                      (uint64_t)fs.max_files * sizeof(MetadataEntry);
+    if (fs.total_size < tables + 16 * fs.block_size) {
+        error = "total_size " + std::to_string(fs.total_size) + " leaves no room for data: the tables need " +
+                std::to_string(tables) + " bytes plus at least 16 blocks";
+        return false;
+    }
+    if (config.server.port == config.http_port ||
+        (config.server.binary_port != 0 &&
+         (config.server.binary_port == config.http_port || config.server.binary_port == config.server.port))) {
+        error = "port, socket_port and binary_port must all differ";
+        return false;
+    }
+    return true;
+}
+
+bool load_config(const std::string& path, OFSConfig& config, std::string& error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Config warning: " << path << " not found, using built-in defaults" << std::endl;
+        return true;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string text = buffer.str();
+
+    OFSConfig parsed = config;
+    std::istringstream lines(text);
+    std::string line, section;
+    int line_number = 0;
+    while (std::getline(lines, line)) {
+        ++line_number;
+        std::string where = path + ":" + std::to_string(line_number) + ": ";
+        line = trim(strip_comment(line));
+        if (line.empty()) continue;
+
+        if (line.front() == '[') {
+            if (line.back() != ']') { error = where + "unterminated section header"; return false; }
+            section = trim(line.substr(1, line.size() - 2));
+            continue;
+        }
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) { error = where + "expected 'key = value'"; return false; }
+        std::string key = trim(line.substr(0, equals));
+        std::string value = trim(line.substr(equals + 1));
+        if (key.empty()) { error = where + "missing key"; return false; }
+        if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+            value = value.substr(1, value.size() - 2);
+        } else if (!value.empty() && (value.front() == '"' || value.back() == '"')) {
+            error = where + "unbalanced quotes in value of '" + key + "'";
+            return false;
+        }
+
+        bool known = true;
+        std::string problem;
+        if (!apply_setting(parsed, section, key, value, known, problem)) {
+            error = where + problem;
+            return false;
+        }
+        if (!known) {
+            std::cerr << "Config warning: " << where << "unknown key '" << key << "' in ["
+                      << section << "], ignored" << std::endl;
+        }
+    }
+    if (!validate(parsed, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+
+    parsed.source = path;
+    parsed.hash = sha256_hex(text);
+    config = parsed;
+    return true;
+}
@@ -6,28 +6,62 @@
 #include <cstring>
 #include <sstream>
 #include <cstdlib>
+#include <cstdio>
 #include <random>
 #include <algorithm>
+#include <set>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
 
 #include "../include/FileSystem.h"
 #include "../include/UserMap.h"
+#include "../include/LockManager.h"
+#include "../include/IoBackend.h"
+#include "../include/Log.h"
 
 // --- Helper Function Prototypes ---
-int find_entry_by_path(OFSystem& fs_instance, const std::string& path);
+int find_entry_by_path(OFSystem& fs_instance, const std::string& path, const AccessContext* caller = nullptr);
+uint32_t effective_permissions(const MetadataEntry& entry);
+bool has_access(const AccessContext& caller, const MetadataEntry& entry, uint32_t wanted);
+void require_access(OFSystem& fs_instance, const AccessContext& caller, uint32_t entry_index, uint32_t wanted);
+int resolve_path(OFSystem& fs_instance, const std::string& path, const AccessContext& caller, uint32_t wanted, uint32_t* parent_index = nullptr);
+bool entry_is_directory(OFSystem& fs_instance, uint32_t entry_index);
+void persist_metadata_entry(OFSystem& fs_instance, uint32_t entry_index, const MetadataEntry& entry);
+void publish_entry(OFSystem& fs_instance, uint32_t entry_index, const MetadataEntry& entry);
+void release_entry(OFSystem& fs_instance, uint32_t entry_index, const MetadataEntry& removed, bool free_blocks);
+
+// In-memory only validity state: the slot is claimed by an in-flight create or
+// remove, so lookups skip it and the allocator will not hand it out.
+const uint8_t ENTRY_RESERVED = 2;
 int find_free_metadata_entry(OFSystem& fs_instance);
-int find_free_block(OFSystem& fs_instance);
+// Files occupy a contiguous extent of blocks starting at start_index.
+uint32_t blocks_for_size(const OFSystem& fs_instance, uint64_t size);
+int find_free_extent(OFSystem& fs_instance, uint32_t block_count);
+void mark_extent(OFSystem& fs_instance, uint32_t start_block, uint32_t block_count, bool is_free);
+void free_extent(OFSystem& fs_instance, uint32_t file_start, uint32_t start_block, uint32_t block_count);
+uint64_t data_block_offset(const OFSystem& fs_instance, uint32_t block_index);
+bool container_io(OFSystem& fs_instance, bool is_write, uint64_t offset, char* buffer, size_t length);
 std::string generate_session_id();
+void rebuild_user_usage(OFSystem& fs_instance);
+bool write_header(OFSystem& fs_instance);
+bool save_free_map(OFSystem& fs_instance);
+bool load_free_map(OFSystem& fs_instance);
+void check_name_length(const OFSystem& fs_instance, const std::string& name);
+void charge_quota(OFSystem& fs_instance, uint32_t owner_id, uint64_t bytes, uint32_t inodes);
+void release_quota(OFSystem& fs_instance, uint32_t owner_id, uint64_t bytes, uint32_t inodes);
 
 // ============================================================================
 // CORE SYSTEM FUNCTIONS
 // ============================================================================
 
-void format_filesystem(const std::string& filepath) {
-    std::cout << "Formatting new filesystem: " << filepath << std::endl;
-    const uint64_t TOTAL_FS_SIZE = 100 * 1024 * 1024;
-    const uint64_t BLOCK_SIZE = 4096;
-    const uint32_t METADATA_COUNT = 1000;
-    const uint32_t MAX_USERS = 50;
+void format_filesystem(const std::string& filepath, const OFSConfig& config) {
+    LOG_INFO("Formatting new filesystem").kv("path", filepath);
+    const uint64_t TOTAL_FS_SIZE = config.filesystem.total_size;
+    const uint64_t BLOCK_SIZE = config.filesystem.block_size;
+    const uint32_t METADATA_COUNT = config.filesystem.max_files;
+    const uint32_t MAX_USERS = config.security.max_users;
     OMNIHeader header = {};
     memcpy(header.magic, "OMNIFS01", sizeof(header.magic));
     header.format_version = 0x00010000;
@@ -35,14 +69,21 @@ void format_filesystem(const std::string& filepath) {
     header.header_size = sizeof(OMNIHeader);
     header.block_size = BLOCK_SIZE;
     header.max_users = MAX_USERS;
+    header.metadata_count = METADATA_COUNT;
+    header.max_filename_length = (uint8_t)config.filesystem.max_filename_length;
     header.user_table_offset = sizeof(OMNIHeader);
     header.file_state_storage_offset = header.user_table_offset + (MAX_USERS * sizeof(UserInfo));
+    memcpy(header.config_hash, config.hash.data(), std::min(config.hash.size(), sizeof(header.config_hash)));
+    header.config_timestamp = time(nullptr);
 
-    std::vector<UserInfo> user_table(MAX_USERS, UserInfo{});
-    UserInfo& admin_user = user_table[0];
-    strncpy(admin_user.username, "admin", sizeof(admin_user.username) - 1);
-    strncpy(admin_user.password_hash, "admin123", sizeof(admin_user.password_hash) - 1);
+    // Built as a local and assigned: the config parser rejects max_users = 0,
+    // but the compiler cannot see that user_table[0] exists.
+    UserInfo admin_user = {};
+    strncpy(admin_user.username, config.security.admin_username.c_str(), sizeof(admin_user.username) - 1);
+    strncpy(admin_user.password_hash, config.security.admin_password.c_str(), sizeof(admin_user.password_hash) - 1);
     admin_user.role = 1; admin_user.is_active = 1; admin_user.created_time = time(nullptr);
+    std::vector<UserInfo> user_table(MAX_USERS, UserInfo{});
+    user_table.front() = admin_user;
 
     std::vector<MetadataEntry> metadata_table(METADATA_COUNT, MetadataEntry{});
     for(size_t i = 0; i < METADATA_COUNT; ++i) { metadata_table[i].validity_flag = 1; }
@@ -50,7 +91,7 @@ void format_filesystem(const std::string& filepath) {
     MetadataEntry& root_dir = metadata_table[0];
     root_dir.validity_flag = 0; root_dir.type_flag = 1; root_dir.parent_index = 0;
     strncpy(root_dir.short_name, "/", sizeof(root_dir.short_name) - 1);
-    root_dir.owner_id = 0; root_dir.created_time = time(nullptr); root_dir.modified_time = time(nullptr);
+    root_dir.owner_id = 0; root_dir.permissions = DEFAULT_ROOT_PERMISSIONS; root_dir.created_time = time(nullptr); root_dir.modified_time = time(nullptr);
     
     std::ofstream ofs(filepath, std::ios::binary | std::ios::trunc);
     ofs.write(reinterpret_cast<const char*>(&header), sizeof(OMNIHeader));
@@ -61,78 +102,266 @@ void format_filesystem(const std::string& filepath) {
     std::vector<char> empty_space(TOTAL_FS_SIZE - current_size, 0);
     ofs.write(empty_space.data(), empty_space.size());
     ofs.close();
-    std::cout << "Format complete!" << std::endl;
+    LOG_INFO("Format complete");
 }
 
-void init_filesystem(OFSystem& fs_instance, const std::string& filepath) {
-    std::cout << "\nInitializing file system from: " << filepath << std::endl;
+void init_filesystem(OFSystem& fs_instance, const std::string& filepath, const OFSConfig& config) {
+    LOG_INFO("Initializing file system").kv("path", filepath);
     fs_instance.omni_filepath = filepath;
     std::ifstream ifs(filepath, std::ios::binary);
     if (!ifs) { std::cerr << "Error opening file: " << filepath << std::endl; exit(1); }
     
     ifs.read(reinterpret_cast<char*>(&fs_instance.header), sizeof(OMNIHeader));
+    // The container's own geometry wins over [filesystem]/[security] sizing,
+    // which only applies when formatting.
+    std::string stored_hash(fs_instance.header.config_hash, strnlen(fs_instance.header.config_hash, sizeof(fs_instance.header.config_hash)));
+    if (!config.hash.empty() && stored_hash != config.hash) {
+        LOG_INFO("Config differs from the one this container was formatted with; its sizing settings apply only to new containers")
+            .kv("config", config.source);
+    }
     fs_instance.user_table.resize(fs_instance.header.max_users);
     ifs.read(reinterpret_cast<char*>(fs_instance.user_table.data()), fs_instance.header.max_users * sizeof(UserInfo));
     
     fs_instance.user_map = user_map_create(fs_instance.header.max_users);
+    fs_instance.lock_manager = new LockManager();
     for (size_t i = 0; i < fs_instance.user_table.size(); ++i) {
         if (fs_instance.user_table[i].is_active == 1) {
             user_map_insert(fs_instance.user_map, fs_instance.user_table[i].username, &fs_instance.user_table[i]);
         }
     }
     
-    const uint32_t METADATA_COUNT = 1000;
+    const uint32_t METADATA_COUNT = fs_instance.header.metadata_count ? fs_instance.header.metadata_count : 1000;
     fs_instance.metadata_entries.resize(METADATA_COUNT);
+    fs_instance.entry_generations.assign(METADATA_COUNT, 0);
     ifs.seekg(fs_instance.header.file_state_storage_offset);
     ifs.read(reinterpret_cast<char*>(fs_instance.metadata_entries.data()), METADATA_COUNT * sizeof(MetadataEntry));
+    if (fs_instance.metadata_entries[0].permissions == 0) { fs_instance.metadata_entries[0].permissions = DEFAULT_ROOT_PERMISSIONS; }
     
     uint64_t data_area_start = fs_instance.header.file_state_storage_offset + (METADATA_COUNT * sizeof(MetadataEntry));
     uint64_t total_data_blocks = (fs_instance.header.total_size - data_area_start) / fs_instance.header.block_size;
     fs_instance.free_block_map.assign(total_data_blocks, true);
-    for(const auto& entry : fs_instance.metadata_entries) {
-        if (entry.validity_flag == 0 && entry.start_index > 0) {
-            if (entry.start_index < fs_instance.free_block_map.size()) {
-                fs_instance.free_block_map[entry.start_index] = false;
+    bool was_clean = fs_instance.header.clean_unmount == 1;
+    bool map_loaded = was_clean && load_free_map(fs_instance);
+    if (map_loaded) {
+        LOG_INFO("Clean unmount: free map and usage loaded, metadata scan skipped");
+    } else {
+        if (was_clean) { LOG_WARN("Saved free map unusable; rebuilding it from metadata"); }
+        fs_instance.free_block_map.assign(total_data_blocks, true);
+        for(const auto& entry : fs_instance.metadata_entries) {
+            if (entry.validity_flag == 0 && entry.type_flag == 0 && entry.start_index > 0) {
+                mark_extent(fs_instance, entry.start_index, blocks_for_size(fs_instance, entry.total_size), false);
             }
         }
     }
     ifs.close();
-    std::cout << "File system loaded into memory." << std::endl;
+    fs_instance.omni_fd = open(filepath.c_str(), O_RDWR | O_CLOEXEC);
+    if (fs_instance.omni_fd < 0) {
+        throw OFSException(OFS_ERROR_IO_ERROR, "Cannot open " + filepath + " for reading and writing: " + strerror(errno));
+    }
+    // Cleared before any request runs, so a crash from here on makes the next
+    // start rebuild the free map instead of trusting a stale one.
+    if (fs_instance.header.clean_unmount != 0) {
+        fs_instance.header.clean_unmount = 0;
+        write_header(fs_instance);
+    }
+    fs_instance.io_backend = new IoBackend(config.io.use_io_uring, config.io.queue_depth, config.io.resume_threads);
+    if (!map_loaded) { rebuild_user_usage(fs_instance); }
+    restore_session_snapshot(fs_instance);
+    LOG_INFO("File system loaded into memory");
+}
+
+// Called with g_fs_mutex held exclusively once the front ends have drained.
+// Everything but file content is written through as it changes, so what is
+// left is the session snapshot, an fdatasync and the clean-unmount record.
+// The record is only written when no create is half done and no free is
+// parked behind a pinned extent; otherwise the saved free map would not
+// match the metadata and the next start rebuilds it instead.
+void shutdown_filesystem(OFSystem& fs_instance) {
+    LOG_INFO("Shutting down file system");
+    save_session_snapshot(fs_instance);
+
+    bool quiescent = true;
+    for (const auto& entry : fs_instance.metadata_entries) {
+        if (entry.validity_flag == ENTRY_RESERVED) { quiescent = false; break; }
+    }
+    {
+        std::lock_guard<std::mutex> alloc(fs_instance.lock_manager->allocator_lock());
+        quiescent = quiescent && fs_instance.deferred_extent_frees.empty() && save_free_map(fs_instance);
+    }
+    if (fdatasync(fs_instance.omni_fd) != 0) { quiescent = false; }
+    if (!quiescent) {
+        LOG_WARN("Operations still in progress; the next start will rebuild the free map");
+        return;
+    }
+    fs_instance.header.clean_unmount = 1;
+    if (write_header(fs_instance)) {
+        LOG_INFO("Clean unmount recorded");
+    }
 }
 
-void shutdown_filesystem() {
-    std::cout << "\n--- Shutting down server ---" << std::endl;
-    exit(0);
+bool write_header(OFSystem& fs_instance) {
+    ssize_t written = pwrite(fs_instance.omni_fd, &fs_instance.header, sizeof(OMNIHeader), 0);
+    return written == (ssize_t)sizeof(OMNIHeader) && fdatasync(fs_instance.omni_fd) == 0;
+}
+
+// The free map is saved to a sidecar (<omni file>.freemap) as one bit per
+// block, set when free, followed by the per-user usage counters, so a clean
+// start needs neither from a metadata scan. It is only trusted while the
+// header's clean_unmount flag is set, which happens after the sidecar is on
+// disk.
+static const char FREE_MAP_MAGIC[] = "OFSFREE2";   // 2: usage counters appended
+
+bool save_free_map(OFSystem& fs_instance) {
+    const std::vector<bool>& map = fs_instance.free_block_map;
+    uint64_t count = map.size();
+    std::vector<uint8_t> bits((count + 7) / 8, 0);
+    for (uint64_t i = 0; i < count; ++i) {
+        if (map[i]) { bits[i / 8] |= (uint8_t)(1u << (i % 8)); }
+    }
+    uint64_t user_count = fs_instance.user_usage.size();
+    std::string data(FREE_MAP_MAGIC, 8);
+    data.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    data.append(reinterpret_cast<const char*>(bits.data()), bits.size());
+    data.append(reinterpret_cast<const char*>(&user_count), sizeof(user_count));
+    data.append(reinterpret_cast<const char*>(fs_instance.user_usage.data()), user_count * sizeof(UserUsage));
+
+    int fd = open((fs_instance.omni_filepath + ".freemap").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) { return false; }
+    bool saved = write(fd, data.data(), data.size()) == (ssize_t)data.size() && fsync(fd) == 0;
+    close(fd);
+    return saved;
+}
+
+// Consumed on load, like the session snapshot.
+bool load_free_map(OFSystem& fs_instance) {
+    std::string map_path = fs_instance.omni_filepath + ".freemap";
+    std::ifstream ifs(map_path, std::ios::binary);
+    if (!ifs) { return false; }
+    char magic[8] = {};
+    uint64_t count = 0;
+    ifs.read(magic, sizeof(magic));
+    ifs.read(reinterpret_cast<char*>(&count), sizeof(count));
+    bool valid = ifs && memcmp(magic, FREE_MAP_MAGIC, sizeof(magic)) == 0 && count == fs_instance.free_block_map.size();
+    std::vector<uint8_t> bits(valid ? (count + 7) / 8 : 0);
+    if (valid) { ifs.read(reinterpret_cast<char*>(bits.data()), bits.size()); }
+    uint64_t user_count = 0;
+    ifs.read(reinterpret_cast<char*>(&user_count), sizeof(user_count));
+    valid = valid && ifs && user_count == fs_instance.user_table.size();
+    std::vector<UserUsage> usage(valid ? user_count : 0);
+    if (valid) { ifs.read(reinterpret_cast<char*>(usage.data()), user_count * sizeof(UserUsage)); }
+    valid = valid && ifs;
+    ifs.close();
+    std::remove(map_path.c_str());
+    if (!valid) { return false; }
+    for (uint64_t i = 0; i < count; ++i) {
+        fs_instance.free_block_map[i] = (bits[i / 8] >> (i % 8)) & 1;
+    }
+    fs_instance.user_usage = std::move(usage);
+    return true;
+}
+
+// Sessions survive a graceful restart through a small sidecar file next to
+// the container, so an upgrade does not force every client to log in again.
+// Version 2 records identify the account as well as its slot.
+static const char SESSION_SNAPSHOT_MAGIC[] = "OFSSESS2";
+void save_session_snapshot(OFSystem& fs_instance) {
+    uint64_t now = time(nullptr);
+    std::vector<SessionSnapshotRecord> records;
+    for (const auto& session : fs_instance.active_sessions) {
+        if (session.second.expires_at <= now) { continue; }
+        SessionSnapshotRecord record = {};
+        // Ids fill the field exactly, so it is not NUL-terminated; restore reads it with strnlen.
+        memcpy(record.session_id, session.first.data(), std::min(session.first.size(), sizeof(record.session_id)));
+        record.uid = session.second.access.uid;
+        record.login_time = session.second.login_time;
+        record.expires_at = session.second.expires_at;
+        const char* username = session.second.user->username;
+        memcpy(record.username, username, strnlen(username, sizeof(record.username) - 1));   // Zeroed: stays terminated
+        record.user_created_time = session.second.user->created_time;
+        records.push_back(record);
+    }
+    uint32_t count = records.size();
+    std::string data(SESSION_SNAPSHOT_MAGIC, 8);
+    data.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    data.append(reinterpret_cast<const char*>(records.data()), count * sizeof(SessionSnapshotRecord));
+
+    // The records are live bearer tokens: owner-only, including when an older
+    // snapshot with wider permissions is being overwritten.
+    int fd = open((fs_instance.omni_filepath + ".sessions").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) { LOG_WARN("Could not save sessions for warm restart").kv("error", strerror(errno)); return; }
+    bool saved = fchmod(fd, 0600) == 0 && write(fd, data.data(), data.size()) == (ssize_t)data.size();
+    close(fd);
+    if (!saved) { LOG_WARN("Could not save sessions for warm restart").kv("error", strerror(errno)); return; }
+    LOG_INFO("Saved sessions for warm restart").kv("count", count);
+}
+
+// The snapshot is consumed on load so a later crash cannot resurrect sessions
+// that were logged out after this restart.
+void restore_session_snapshot(OFSystem& fs_instance) {
+    std::string snapshot_path = fs_instance.omni_filepath + ".sessions";
+    std::ifstream ifs(snapshot_path, std::ios::binary);
+    if (!ifs) { return; }
+    char magic[8] = {};
+    uint32_t count = 0;
+    ifs.read(magic, sizeof(magic));
+    ifs.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!ifs || memcmp(magic, SESSION_SNAPSHOT_MAGIC, sizeof(magic)) != 0) { count = 0; }
+    std::vector<SessionSnapshotRecord> records(count);
+    ifs.read(reinterpret_cast<char*>(records.data()), count * sizeof(SessionSnapshotRecord));
+    if (!ifs) { records.clear(); }
+    ifs.close();
+    std::remove(snapshot_path.c_str());
+
+    uint64_t now = time(nullptr);
+    size_t restored = 0;
+    for (const auto& record : records) {
+        if (record.expires_at <= now || record.uid >= fs_instance.user_table.size()) { continue; }
+        UserInfo* user = &fs_instance.user_table[record.uid];
+        if (user->is_active != 1 || user->created_time != record.user_created_time ||
+            strncmp(user->username, record.username, sizeof(record.username)) != 0) { continue; }
+        std::string session_id(record.session_id, strnlen(record.session_id, sizeof(record.session_id)));
+        fs_instance.active_sessions[session_id] = {user, {record.uid, user->role}, record.login_time, record.expires_at};
+        ++restored;
+    }
+    LOG_INFO("Restored sessions from snapshot").kv("count", restored);
+}
+
+ActiveSession* find_active_session(OFSystem& fs_instance, const std::string& session_id) {
+    auto it = fs_instance.active_sessions.find(session_id);
+    if (it == fs_instance.active_sessions.end() || it->second.expires_at <= (uint64_t)time(nullptr)) { return nullptr; }
+    return &it->second;
 }
 
 // ============================================================================
 // USER MANAGEMENT
 // ============================================================================
 std::string login_user(OFSystem& fs_instance, const std::string& username, const std::string& password) {
-    std::cout << "\n--- Attempting Login for user: " << username << " ---" << std::endl;
+    LOG_DEBUG("Login attempt").kv("user", username);
     UserInfo* user = user_map_get(fs_instance.user_map, username);
-    if (user != nullptr && strcmp(user->password_hash, password.c_str()) == 0) {
-        std::cout << "Login successful! Generating session..." << std::endl;
+    if (user != nullptr && user->is_active == 1 && strcmp(user->password_hash, password.c_str()) == 0) {
+        LOG_DEBUG("Login successful").kv("user", username);
         std::string session_id = generate_session_id();
-        fs_instance.active_sessions[session_id] = user;
+        uint64_t now = time(nullptr);
+        for (auto it = fs_instance.active_sessions.begin(); it != fs_instance.active_sessions.end();) {
+            if (it->second.expires_at <= now) { it = fs_instance.active_sessions.erase(it); } else { ++it; }
+        }
+        fs_instance.active_sessions[session_id] = {user, {user_id_of(fs_instance, user), user->role}, now, now + SESSION_TTL_SECONDS};
         user->last_login = time(nullptr);
         return session_id;
     }
-    std::cout << "Login failed: Invalid username or password." << std::endl;
+    LOG_INFO("Login failed: invalid username or password").kv("user", username);
     return "";
 }
 
 void logout_user(OFSystem& fs_instance, const std::string& session_id) {
-    std::cout << "\n--- Logging out session: " << session_id << " ---" << std::endl;
     if (fs_instance.active_sessions.erase(session_id) > 0) {
-        std::cout << "Session successfully logged out." << std::endl;
+        LOG_DEBUG("Session logged out");
     } else {
-        std::cout << "Warning: Logout for a session that does not exist." << std::endl;
+        LOG_DEBUG("Logout for a session that does not exist");
     }
 }
 
 void create_user(OFSystem& fs_instance, const std::string& username, const std::string& password, uint32_t role) {
-    std::cout << "\n--- Creating new user: " << username << " ---" << std::endl;
     int free_slot = -1;
     for (size_t i = 0; i < fs_instance.user_table.size(); ++i) {
         if (fs_instance.user_table[i].is_active == 0) {
@@ -140,7 +369,7 @@ void create_user(OFSystem& fs_instance, const std::string& username, const std::
             break;
         }
     }
-    if (free_slot == -1) { std::cout << "Error: No free user slots available." << std::endl; return; }
+    if (free_slot == -1) { LOG_WARN("No free user slots available").kv("user", username); return; }
     
     UserInfo& new_user = fs_instance.user_table[free_slot];
     new_user.is_active = 1;
@@ -148,6 +377,8 @@ void create_user(OFSystem& fs_instance, const std::string& username, const std::
     strncpy(new_user.username, username.c_str(), sizeof(new_user.username) - 1);
     strncpy(new_user.password_hash, password.c_str(), sizeof(new_user.password_hash) - 1);
     new_user.created_time = time(nullptr);
+    memset(new_user.reserved, 0, sizeof(new_user.reserved));
+    fs_instance.user_usage[free_slot] = UserUsage{};
     
     user_map_insert(fs_instance.user_map, new_user.username, &new_user);
     
@@ -155,12 +386,62 @@ void create_user(OFSystem& fs_instance, const std::string& username, const std::
     file.seekp(fs_instance.header.user_table_offset);
     file.write(reinterpret_cast<const char*>(fs_instance.user_table.data()), fs_instance.header.max_users * sizeof(UserInfo));
     file.close();
-    std::cout << "Successfully created user '" << username << "'." << std::endl;
+    LOG_INFO("Created user").kv("user", username);
+}
+
+// Validates the whole list first, then fills free slots in a single forward
+// pass and persists the user table with one write. Returns one OFSResult per
+// request, in order.
+std::vector<int32_t> create_users_batch(OFSystem& fs_instance, const std::vector<NewUserRequest>& requests) {
+    std::vector<int32_t> results(requests.size(), OFS_SUCCESS);
+    std::set<std::string> accepted;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        const NewUserRequest& request = requests[i];
+        if (request.username.empty() || request.username.length() >= sizeof(UserInfo::username) ||
+            request.password.length() >= sizeof(UserInfo::password_hash) || request.role > 1) {
+            results[i] = OFS_ERROR_INVALID_OPERATION;
+            continue;
+        }
+        UserInfo* existing = user_map_get(fs_instance.user_map, request.username);
+        if ((existing != nullptr && existing->is_active == 1) ||
+            accepted.count(request.username) > 0) {
+            results[i] = OFS_ERROR_FILE_EXISTS;
+            continue;
+        }
+        accepted.insert(request.username);
+    }
+
+    size_t next_slot = 0;
+    int created = 0;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (results[i] != OFS_SUCCESS) { continue; }
+        while (next_slot < fs_instance.user_table.size() && fs_instance.user_table[next_slot].is_active != 0) { ++next_slot; }
+        if (next_slot == fs_instance.user_table.size()) { results[i] = OFS_ERROR_NO_SPACE; continue; }
+
+        UserInfo& new_user = fs_instance.user_table[next_slot];
+        new_user = UserInfo{};
+        new_user.is_active = 1;
+        new_user.role = requests[i].role;
+        strncpy(new_user.username, requests[i].username.c_str(), sizeof(new_user.username) - 1);
+        strncpy(new_user.password_hash, requests[i].password.c_str(), sizeof(new_user.password_hash) - 1);
+        new_user.created_time = time(nullptr);
+        fs_instance.user_usage[next_slot] = UserUsage{};
+        user_map_insert(fs_instance.user_map, new_user.username, &new_user);
+        ++created;
+    }
+
+    if (created > 0) {
+        std::fstream file(fs_instance.omni_filepath, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(fs_instance.header.user_table_offset);
+        file.write(reinterpret_cast<const char*>(fs_instance.user_table.data()), fs_instance.header.max_users * sizeof(UserInfo));
+        file.close();
+    }
+    LOG_INFO("Batch user creation").kv("created", created).kv("requested", requests.size());
+    return results;
 }
 
 void delete_user(OFSystem& fs_instance, const std::string& username) {
-    std::cout << "\n--- Deleting user: " << username << " ---" << std::endl;
-    if (username == "admin") { std::cout << "Error: Cannot delete the admin user." << std::endl; return; }
+    if (username == "admin") { LOG_WARN("Cannot delete the admin user"); return; }
     
     int user_slot = -1;
     for (size_t i = 0; i < fs_instance.user_table.size(); ++i) {
@@ -169,16 +450,31 @@ void delete_user(OFSystem& fs_instance, const std::string& username) {
             break;
         }
     }
-    if (user_slot == -1) { std::cout << "Error: User '" << username << "' not found." << std::endl; return; }
-    
-    fs_instance.user_table[user_slot].is_active = 0;
+    if (user_slot == -1) { LOG_WARN("User not found").kv("user", username); return; }
+
+    // Entries record their owner by slot, and the next user created takes
+    // the first free slot, so it would inherit whatever is left here.
+    for (size_t i = 1; i < fs_instance.metadata_entries.size(); ++i) {
+        const MetadataEntry& entry = fs_instance.metadata_entries[i];
+        if (entry.validity_flag != 1 && entry.owner_id == (uint32_t)user_slot) {
+            throw OFSException(OFS_ERROR_DIRECTORY_NOT_EMPTY, "User '" + username + "' still owns files; remove them first");
+        }
+    }
+
+    UserInfo* user = &fs_instance.user_table[user_slot];
+    user->is_active = 0;
+    user_map_remove(fs_instance.user_map, username);
+    fs_instance.user_usage[user_slot] = UserUsage{};
+    for (auto it = fs_instance.active_sessions.begin(); it != fs_instance.active_sessions.end();) {
+        if (it->second.user == user) { it = fs_instance.active_sessions.erase(it); } else { ++it; }
+    }
     
     std::fstream file(fs_instance.omni_filepath, std::ios::in | std::ios::out | std::ios::binary);
     file.seekp(fs_instance.header.user_table_offset + (user_slot * sizeof(UserInfo)));
     file.write(reinterpret_cast<const char*>(&fs_instance.user_table[user_slot]), sizeof(UserInfo));
     file.close();
     
-    std::cout << "Successfully deleted user '" << username << "'." << std::endl;
+    LOG_INFO("Deleted user").kv("user", username);
 }
 
 std::vector<std::string> list_all_users(OFSystem& fs_instance) {
@@ -192,9 +488,9 @@ std::vector<std::string> list_all_users(OFSystem& fs_instance) {
 }
 
 SessionInfo get_session_details(OFSystem& fs_instance, const std::string& session_id) {
-    auto it = fs_instance.active_sessions.find(session_id);
-    if (it != fs_instance.active_sessions.end()) {
-        return {it->second->username, it->second->role};
+    ActiveSession* session = find_active_session(fs_instance, session_id);
+    if (session != nullptr) {
+        return {session->user->username, session->user->role};
     }
     return {};
 }
@@ -202,8 +498,14 @@ SessionInfo get_session_details(OFSystem& fs_instance, const std::string& sessio
 // ============================================================================
 // DIRECTORY AND FILE OPERATIONS
 // ============================================================================
-void create_directory(OFSystem& fs_instance, const std::string& path) {
-    std::cout << "\n--- Creating Directory: " << path << " ---" << std::endl;
+// Locking follows LockManager's order: stripes, then the namespace lock, then
+// the allocator lock. Paths are resolved under a shared namespace lock; the
+// operation then locks the stripes it needs and re-checks the entry, since it
+// may have been removed between resolution and locking.
+
+void create_directory(OFSystem& fs_instance, const std::string& path, const AccessContext& caller) {
+    LOG_DEBUG("Creating directory").kv("path", path);
+    LockManager& locks = *fs_instance.lock_manager;
     std::string parent_path = "/"; std::string dirname = path;
     size_t last_slash = path.find_last_of('/');
     if (last_slash != std::string::npos) {
@@ -211,26 +513,37 @@ void create_directory(OFSystem& fs_instance, const std::string& path) {
         if (parent_path.empty()) parent_path = "/";
         dirname = path.substr(last_slash + 1);
     } else if (path.length() > 1 && path[0] == '/') { dirname = path.substr(1); }
-    int parent_index = find_entry_by_path(fs_instance, parent_path);
-    if (parent_index == -1) { std::cout << "Error: Parent directory '" << parent_path << "' not found." << std::endl; return; }
-    int free_entry_index = find_free_metadata_entry(fs_instance);
-    if (free_entry_index == -1) return;
-    MetadataEntry& new_dir = fs_instance.metadata_entries[free_entry_index];
-    new_dir.validity_flag = 0; new_dir.type_flag = 1; new_dir.parent_index = parent_index;
-    strncpy(new_dir.short_name, dirname.c_str(), sizeof(new_dir.short_name) - 1);
-    new_dir.total_size = 0; new_dir.start_index = 0;
-    new_dir.created_time = time(nullptr); new_dir.modified_time = time(nullptr);
-    std::fstream file(fs_instance.omni_filepath, std::ios::in | std::ios::out | std::ios::binary);
-    long meta_position = fs_instance.header.file_state_storage_offset + (free_entry_index * sizeof(MetadataEntry));
-    file.seekp(meta_position);
-    file.write(reinterpret_cast<const char*>(&new_dir), sizeof(MetadataEntry));
-    file.close();
+    check_name_length(fs_instance, dirname);
+    int parent_index = resolve_path(fs_instance, parent_path, caller, PERM_WRITE);
+    if (parent_index == -1) { LOG_WARN("Parent directory not found").kv("path", parent_path); return; }
+    LockManager::Guard guard = locks.lock_entries({(uint32_t)parent_index}, true);
+    int free_entry_index;
+    MetadataEntry new_dir = {};
+    {
+        std::unique_lock<std::shared_mutex> ns(locks.namespace_lock());
+        if (!entry_is_directory(fs_instance, parent_index)) { LOG_WARN("Parent directory was removed").kv("path", parent_path); return; }
+        std::lock_guard<std::mutex> alloc(locks.allocator_lock());
+        free_entry_index = find_free_metadata_entry(fs_instance);
+        if (free_entry_index == -1) return;
+        charge_quota(fs_instance, caller.uid, 0, 1);
+        new_dir.validity_flag = 0; new_dir.type_flag = 1; new_dir.parent_index = parent_index;
+        strncpy(new_dir.short_name, dirname.c_str(), sizeof(new_dir.short_name) - 1);
+        new_dir.total_size = 0; new_dir.start_index = 0;
+        new_dir.owner_id = caller.uid; new_dir.permissions = DEFAULT_DIR_PERMISSIONS;
+        new_dir.created_time = time(nullptr); new_dir.modified_time = time(nullptr);
+        fs_instance.metadata_entries[free_entry_index] = new_dir;
+        fs_instance.metadata_entries[free_entry_index].validity_flag = ENTRY_RESERVED;
+        fs_instance.entry_generations[free_entry_index] = ++fs_instance.next_entry_generation;
+    }
+    publish_entry(fs_instance, free_entry_index, new_dir);
 }
 
-std::vector<DirEntryInfo> list_directory_contents(OFSystem& fs_instance, const std::string& path) {
+std::vector<DirEntryInfo> list_directory_contents(OFSystem& fs_instance, const std::string& path, const AccessContext& caller) {
     std::vector<DirEntryInfo> results;
-    int parent_index = find_entry_by_path(fs_instance, path);
-    if (parent_index == -1) { std::cout << "Error: Directory '" << path << "' not found." << std::endl; return results; }
+    std::shared_lock<std::shared_mutex> ns(fs_instance.lock_manager->namespace_lock());
+    int parent_index = find_entry_by_path(fs_instance, path, &caller);
+    if (parent_index == -1) { LOG_WARN("Directory not found").kv("path", path); return results; }
+    require_access(fs_instance, caller, parent_index, PERM_READ);
     for (const auto& entry : fs_instance.metadata_entries) {
         if (entry.validity_flag == 0 && entry.parent_index == (uint32_t)parent_index) {
             results.push_back({entry.short_name, (entry.type_flag == 1)});
@@ -239,128 +552,121 @@ std::vector<DirEntryInfo> list_directory_contents(OFSystem& fs_instance, const s
     return results;
 }
 
-void remove_directory(OFSystem& fs_instance, const std::string& path) {
-    int entry_index = find_entry_by_path(fs_instance, path);
-    if (entry_index == -1 || entry_index == 0) { std::cout << "Error: Directory not found or cannot delete root." << std::endl; return; }
-    for (const auto& entry : fs_instance.metadata_entries) {
-        if (entry.validity_flag == 0 && entry.parent_index == (uint32_t)entry_index) {
-            std::cout << "Error: Directory is not empty." << std::endl; return;
+void remove_directory(OFSystem& fs_instance, const std::string& path, const AccessContext& caller) {
+    LockManager& locks = *fs_instance.lock_manager;
+    uint32_t parent_index = 0;
+    int entry_index = resolve_path(fs_instance, path, caller, 0, &parent_index);
+    if (entry_index == -1 || entry_index == 0) { LOG_WARN("Directory not found or cannot delete root").kv("path", path); return; }
+    LockManager::Guard guard = locks.lock_entries({parent_index, (uint32_t)entry_index}, true);
+    MetadataEntry removed;
+    {
+        std::unique_lock<std::shared_mutex> ns(locks.namespace_lock());
+        MetadataEntry& entry = fs_instance.metadata_entries[entry_index];
+        if (entry.validity_flag != 0 || entry.parent_index != parent_index) { LOG_WARN("Directory not found or cannot delete root").kv("path", path); return; }
+        require_access(fs_instance, caller, parent_index, PERM_WRITE);
+        for (const auto& child : fs_instance.metadata_entries) {
+            if (child.validity_flag == 0 && child.parent_index == (uint32_t)entry_index) {
+                LOG_WARN("Directory is not empty").kv("path", path); return;
+            }
         }
+        entry.validity_flag = ENTRY_RESERVED;
+        removed = entry;
     }
-    fs_instance.metadata_entries[entry_index].validity_flag = 1;
-    std::fstream file(fs_instance.omni_filepath, std::ios::in | std::ios::out | std::ios::binary);
-    long position = fs_instance.header.file_state_storage_offset + (entry_index * sizeof(MetadataEntry));
-    file.seekp(position);
-    file.write(reinterpret_cast<const char*>(&fs_instance.metadata_entries[entry_index]), sizeof(MetadataEntry));
-    file.close();
+    removed.validity_flag = 1;
+    persist_metadata_entry(fs_instance, entry_index, removed);
+    release_entry(fs_instance, entry_index, removed, false);
 }
 
-bool path_is_directory(OFSystem& fs_instance, const std::string& path) {
-    int entry_index = find_entry_by_path(fs_instance, path);
+bool path_is_directory(OFSystem& fs_instance, const std::string& path, const AccessContext& caller) {
+    std::shared_lock<std::shared_mutex> ns(fs_instance.lock_manager->namespace_lock());
+    int entry_index = find_entry_by_path(fs_instance, path, &caller);
     return (entry_index != -1 && fs_instance.metadata_entries[entry_index].type_flag == 1);
 }
 
-void create_file_with_content(OFSystem& fs_instance, const std::string& path, const std::string& content) {
-    std::string parent_path = "/"; std::string filename = path;
-    size_t last_slash = path.find_last_of('/');
-    if (last_slash != std::string::npos) {
-        parent_path = path.substr(0, last_slash);
-        if (parent_path.empty()) parent_path = "/";
-        filename = path.substr(last_slash + 1);
-    } else if (path.length() > 0 && path[0] == '/') { filename = path.substr(1); }
-    int parent_index = find_entry_by_path(fs_instance, parent_path);
-    if (parent_index == -1) { std::cout << "Error: Parent directory '" << parent_path << "' not found." << std::endl; return; }
-    int free_entry_index = find_free_metadata_entry(fs_instance);
-    if (free_entry_index == -1) return;
-    int free_block_index = find_free_block(fs_instance);
-    if (free_block_index == -1) return;
-    MetadataEntry& new_file = fs_instance.metadata_entries[free_entry_index];
-    new_file.validity_flag = 0; new_file.type_flag = 0; new_file.parent_index = parent_index;
-    strncpy(new_file.short_name, filename.c_str(), sizeof(new_file.short_name) - 1);
-    new_file.total_size = content.length(); new_file.start_index = free_block_index;
-    new_file.created_time = time(nullptr); new_file.modified_time = time(nullptr);
-    fs_instance.free_block_map[free_block_index] = false;
-    std::fstream file(fs_instance.omni_filepath, std::ios::in | std::ios::out | std::ios::binary);
-    long meta_position = fs_instance.header.file_state_storage_offset + (free_entry_index * sizeof(MetadataEntry));
-    file.seekp(meta_position);
-    file.write(reinterpret_cast<const char*>(&new_file), sizeof(MetadataEntry));
-    long data_area_start = fs_instance.header.file_state_storage_offset + (1000 * sizeof(MetadataEntry));
-    long data_position = data_area_start + (free_block_index * fs_instance.header.block_size);
-    file.seekp(data_position);
-    file.write(content.c_str(), content.length());
-    file.close();
+// Reserve, write, publish: the upload steps with the whole body in hand.
+void create_file_with_content(OFSystem& fs_instance, const std::string& path, const std::string& content, const AccessContext& caller) {
+    FileUpload upload;
+    begin_file_upload(fs_instance, path, content.length(), upload, caller);
+    if (!write_file_upload(fs_instance, upload, content.data(), content.length())) {
+        abort_file_upload(fs_instance, upload);
+        throw OFSException(OFS_ERROR_IO_ERROR, "Failed to write file content");
+    }
+    finish_file_upload(fs_instance, upload);
 }
 
-std::string read_file_content(OFSystem& fs_instance, const std::string& path) {
-    int entry_index = find_entry_by_path(fs_instance, path);
-    if (entry_index != -1) {
-        const auto& entry = fs_instance.metadata_entries[entry_index];
-        if (entry.type_flag == 1) { std::cout << "Error: Cannot read a directory." << std::endl; return ""; }
-        std::ifstream ifs(fs_instance.omni_filepath, std::ios::binary);
-        long data_area_start = fs_instance.header.file_state_storage_offset + (1000 * sizeof(MetadataEntry));
-        long data_position = data_area_start + (entry.start_index * fs_instance.header.block_size);
-        ifs.seekg(data_position);
-        std::vector<char> buffer(entry.total_size);
-        ifs.read(buffer.data(), entry.total_size);
-        return std::string(buffer.data(), entry.total_size);
-    }
-    std::cout << "File not found at path: " << path << std::endl;
-    return "";
+// The extent is pinned rather than its stripe held, so the read itself runs
+// with no lock and the blocks cannot be reused underneath it.
+std::string read_file_content(OFSystem& fs_instance, const std::string& path, const AccessContext& caller) {
+    FileExtent extent = pin_file_extent(fs_instance, path, caller);
+    ExtentPin pin(fs_instance, extent);
+    std::string content(extent.length, '\0');
+    bool read = container_io(fs_instance, false, extent.offset, &content[0], content.size());
+    if (!read) throw OFSException(OFS_ERROR_IO_ERROR, "Failed to read file content");
+    return content;
 }
 
-void remove_file(OFSystem& fs_instance, const std::string& path) {
-    int entry_index = find_entry_by_path(fs_instance, path);
-    if (entry_index == -1) { std::cout << "Error: File '" << path << "' not found." << std::endl; return; }
-    int block_to_free = fs_instance.metadata_entries[entry_index].start_index;
-    fs_instance.free_block_map[block_to_free] = true;
-    fs_instance.metadata_entries[entry_index].validity_flag = 1;
-    std::fstream file(fs_instance.omni_filepath, std::ios::in | std::ios::out | std::ios::binary);
-    long position = fs_instance.header.file_state_storage_offset + (entry_index * sizeof(MetadataEntry));
-    file.seekp(position);
-    file.write(reinterpret_cast<const char*>(&fs_instance.metadata_entries[entry_index]), sizeof(MetadataEntry));
-    file.close();
+void remove_file(OFSystem& fs_instance, const std::string& path, const AccessContext& caller) {
+    LockManager& locks = *fs_instance.lock_manager;
+    uint32_t parent_index = 0;
+    int entry_index = resolve_path(fs_instance, path, caller, 0, &parent_index);
+    if (entry_index == -1) { LOG_WARN("File not found").kv("path", path); return; }
+    LockManager::Guard guard = locks.lock_entries({parent_index, (uint32_t)entry_index}, true);
+    MetadataEntry removed;
+    {
+        std::unique_lock<std::shared_mutex> ns(locks.namespace_lock());
+        MetadataEntry& entry = fs_instance.metadata_entries[entry_index];
+        if (entry.validity_flag != 0 || entry.parent_index != parent_index) { LOG_WARN("File not found").kv("path", path); return; }
+        require_access(fs_instance, caller, parent_index, PERM_WRITE);
+        entry.validity_flag = ENTRY_RESERVED;
+        removed = entry;
+    }
+    removed.validity_flag = 1;
+    persist_metadata_entry(fs_instance, entry_index, removed);
+    release_entry(fs_instance, entry_index, removed, true);
 }
 
-void edit_file(OFSystem& fs_instance, const std::string& path, const std::string& new_content, uint32_t index) {
-    int entry_index = find_entry_by_path(fs_instance, path);
-    if (entry_index == -1) { std::cout << "Error: File '" << path << "' not found." << std::endl; return; }
-    MetadataEntry& entry = fs_instance.metadata_entries[entry_index];
-    if (entry.type_flag == 1) { std::cout << "Error: Cannot edit a directory." << std::endl; return; }
-    if (index + new_content.length() > entry.total_size) { std::cout << "Error: Edit exceeds the original file size." << std::endl; return; }
-    long data_area_start = fs_instance.header.file_state_storage_offset + (1000 * sizeof(MetadataEntry));
-    long block_start_pos = data_area_start + (entry.start_index * fs_instance.header.block_size);
-    long final_write_pos = block_start_pos + index;
-    std::fstream file(fs_instance.omni_filepath, std::ios::in | std::ios::out | std::ios::binary);
-    file.seekp(final_write_pos);
-    file.write(new_content.c_str(), new_content.length());
-    entry.modified_time = time(nullptr);
-    file.seekp(fs_instance.header.file_state_storage_offset + (entry_index * sizeof(MetadataEntry)));
-    file.write(reinterpret_cast<const char*>(&entry), sizeof(MetadataEntry));
-    file.close();
+void edit_file(OFSystem& fs_instance, const std::string& path, const std::string& new_content, uint32_t index, const AccessContext& caller) {
+    FileEdit edit;
+    begin_file_edit(fs_instance, path, index, new_content.length(), edit, caller);
+    if (!container_io(fs_instance, true, edit.position, const_cast<char*>(new_content.data()), new_content.length())) {
+        abort_file_edit(fs_instance, edit);
+        throw OFSException(OFS_ERROR_IO_ERROR, "Failed to write file content");
+    }
+    finish_file_edit(fs_instance, edit);
 }
 
-void truncate_file_content(OFSystem& fs_instance, const std::string& path) {
-    int entry_index = find_entry_by_path(fs_instance, path);
-    if (entry_index == -1) { std::cout << "Error: File '" << path << "' not found." << std::endl; return; }
+void truncate_file_content(OFSystem& fs_instance, const std::string& path, const AccessContext& caller) {
+    LockManager& locks = *fs_instance.lock_manager;
+    int entry_index = resolve_path(fs_instance, path, caller, 0);
+    if (entry_index == -1) { LOG_WARN("File not found").kv("path", path); return; }
+    LockManager::Guard guard = locks.lock_entries({(uint32_t)entry_index}, true);
     MetadataEntry& entry = fs_instance.metadata_entries[entry_index];
-    if (entry.type_flag == 1) { std::cout << "Error: Cannot truncate a directory." << std::endl; return; }
-    entry.total_size = 0;
-    entry.modified_time = time(nullptr);
-    std::fstream file(fs_instance.omni_filepath, std::ios::in | std::ios::out | std::ios::binary);
-    long position = fs_instance.header.file_state_storage_offset + (entry_index * sizeof(MetadataEntry));
-    file.seekp(position);
-    file.write(reinterpret_cast<const char*>(&entry), sizeof(MetadataEntry));
-    file.close();
+    {
+        std::unique_lock<std::shared_mutex> ns(locks.namespace_lock());
+        if (entry.validity_flag != 0) { LOG_WARN("File not found").kv("path", path); return; }
+        if (entry.type_flag == 1) { LOG_WARN("Cannot truncate a directory").kv("path", path); return; }
+        require_access(fs_instance, caller, entry_index, PERM_WRITE);
+        std::lock_guard<std::mutex> alloc(locks.allocator_lock());
+        release_quota(fs_instance, entry.owner_id, entry.total_size, 0);
+        // Keep the first block, give the rest of the extent back.
+        free_extent(fs_instance, entry.start_index, entry.start_index + 1, blocks_for_size(fs_instance, entry.total_size) - 1);
+        entry.total_size = 0;
+        entry.modified_time = time(nullptr);
+    }
+    persist_metadata_entry(fs_instance, entry_index, entry);
 }
 
-bool path_is_file(OFSystem& fs_instance, const std::string& path) {
-    int entry_index = find_entry_by_path(fs_instance, path);
+bool path_is_file(OFSystem& fs_instance, const std::string& path, const AccessContext& caller) {
+    std::shared_lock<std::shared_mutex> ns(fs_instance.lock_manager->namespace_lock());
+    int entry_index = find_entry_by_path(fs_instance, path, &caller);
     return (entry_index != -1 && fs_instance.metadata_entries[entry_index].type_flag == 0);
 }
 
-void rename_path(OFSystem& fs_instance, const std::string& old_path, const std::string& new_path) {
-    int entry_index = find_entry_by_path(fs_instance, old_path);
-    if (entry_index == -1 || entry_index == 0) { std::cout << "Error: Source file/directory not found or is root." << std::endl; return; }
+void rename_path(OFSystem& fs_instance, const std::string& old_path, const std::string& new_path, const AccessContext& caller) {
+    LockManager& locks = *fs_instance.lock_manager;
+    uint32_t old_parent_index = 0;
+    int entry_index = resolve_path(fs_instance, old_path, caller, 0, &old_parent_index);
+    if (entry_index == -1 || entry_index == 0) { LOG_WARN("Source file/directory not found or is root").kv("path", old_path); return; }
     std::string new_parent_path = "/"; std::string new_name = new_path;
     size_t last_slash = new_path.find_last_of('/');
     if (last_slash != std::string::npos) {
@@ -368,23 +674,30 @@ void rename_path(OFSystem& fs_instance, const std::string& old_path, const std::
         if (new_parent_path.empty()) new_parent_path = "/";
         new_name = new_path.substr(last_slash + 1);
     } else if (new_path[0] == '/') { new_name = new_path.substr(1); }
-    int new_parent_index = find_entry_by_path(fs_instance, new_parent_path);
-    if (new_parent_index == -1) { std::cout << "Error: Destination directory '" << new_parent_path << "' not found." << std::endl; return; }
+    check_name_length(fs_instance, new_name);
+    int new_parent_index = resolve_path(fs_instance, new_parent_path, caller, 0);
+    if (new_parent_index == -1) { LOG_WARN("Destination directory not found").kv("path", new_parent_path); return; }
+    // Renames within one directory lock a single parent; moves lock both.
+    LockManager::Guard guard = locks.lock_entries({old_parent_index, (uint32_t)new_parent_index, (uint32_t)entry_index}, true);
     MetadataEntry& entry_to_move = fs_instance.metadata_entries[entry_index];
-    entry_to_move.parent_index = new_parent_index;
-    strncpy(entry_to_move.short_name, new_name.c_str(), sizeof(entry_to_move.short_name) - 1);
-    entry_to_move.modified_time = time(nullptr);
-    std::fstream file(fs_instance.omni_filepath, std::ios::in | std::ios::out | std::ios::binary);
-    long position = fs_instance.header.file_state_storage_offset + (entry_index * sizeof(MetadataEntry));
-    file.seekp(position);
-    file.write(reinterpret_cast<const char*>(&entry_to_move), sizeof(MetadataEntry));
-    file.close();
+    {
+        std::unique_lock<std::shared_mutex> ns(locks.namespace_lock());
+        if (entry_to_move.validity_flag != 0 || entry_to_move.parent_index != old_parent_index) { LOG_WARN("Source file/directory not found or is root").kv("path", old_path); return; }
+        if (!entry_is_directory(fs_instance, new_parent_index)) { LOG_WARN("Destination directory not found").kv("path", new_parent_path); return; }
+        require_access(fs_instance, caller, old_parent_index, PERM_WRITE);
+        require_access(fs_instance, caller, new_parent_index, PERM_WRITE);
+        entry_to_move.parent_index = new_parent_index;
+        strncpy(entry_to_move.short_name, new_name.c_str(), sizeof(entry_to_move.short_name) - 1);
+        entry_to_move.modified_time = time(nullptr);
+    }
+    persist_metadata_entry(fs_instance, entry_index, entry_to_move);
 }
 
 FSStats get_fs_stats(OFSystem& fs_instance) {
     FSStats stats = {};
     stats.total_size = fs_instance.header.total_size;
     uint64_t occupied_blocks = 0;
+    std::shared_lock<std::shared_mutex> ns(fs_instance.lock_manager->namespace_lock());
     for (const auto& entry : fs_instance.metadata_entries) {
         if (entry.validity_flag == 0) {
             if (entry.type_flag == 0) {
@@ -398,37 +711,321 @@ FSStats get_fs_stats(OFSystem& fs_instance) {
         }
     }
     stats.used_space = occupied_blocks * fs_instance.header.block_size;
-    stats.free_space = stats.total_size - (fs_instance.header.file_state_storage_offset + (1000 * sizeof(MetadataEntry))) - stats.used_space;
+    stats.free_space = stats.total_size - data_block_offset(fs_instance, 0) - stats.used_space;
     return stats;
 }
 
-FileMetadata get_path_metadata(OFSystem& fs_instance, const std::string& path) {
+FileMetadata get_path_metadata(OFSystem& fs_instance, const std::string& path, const AccessContext& caller) {
+    LockManager& locks = *fs_instance.lock_manager;
     FileMetadata meta = {};
-    int entry_index = find_entry_by_path(fs_instance, path);
+    int entry_index = resolve_path(fs_instance, path, caller, 0);
     if (entry_index != -1) {
+        LockManager::Guard guard = locks.lock_entries({(uint32_t)entry_index}, false);
+        std::shared_lock<std::shared_mutex> ns(locks.namespace_lock());
         const MetadataEntry& entry = fs_instance.metadata_entries[entry_index];
+        if (entry.validity_flag != 0) { return meta; }
         meta.name = entry.short_name;
         meta.is_directory = (entry.type_flag == 1);
         meta.size = entry.total_size;
         meta.owner_id = entry.owner_id;
-        meta.permissions = entry.permissions;
+        meta.permissions = effective_permissions(entry);
         meta.created_time = entry.created_time;
         meta.modified_time = entry.modified_time;
     }
     return meta;
 }
 
-void set_path_permissions(OFSystem& fs_instance, const std::string& path, uint32_t permissions) {
-    int entry_index = find_entry_by_path(fs_instance, path);
+void set_path_permissions(OFSystem& fs_instance, const std::string& path, uint32_t permissions, const AccessContext& caller) {
+    LockManager& locks = *fs_instance.lock_manager;
+    int entry_index = resolve_path(fs_instance, path, caller, 0);
     if (entry_index == -1) { return; }
+    LockManager::Guard guard = locks.lock_entries({(uint32_t)entry_index}, true);
     MetadataEntry& entry = fs_instance.metadata_entries[entry_index];
-    entry.permissions = permissions;
-    entry.modified_time = time(nullptr);
+    {
+        std::unique_lock<std::shared_mutex> ns(locks.namespace_lock());
+        if (entry.validity_flag != 0) { return; }
+        if (caller.role != 1 && entry.owner_id != caller.uid) {
+            throw OFSException(OFS_ERROR_PERMISSION_DENIED, "Only the owner can change permissions");
+        }
+        entry.permissions = permissions;
+        entry.modified_time = time(nullptr);
+    }
+    persist_metadata_entry(fs_instance, entry_index, entry);
+}
+
+// ============================================================================
+// STREAMING TRANSFERS
+// ============================================================================
+// An upload reserves its entry and whole extent up front. Each chunk is then
+// written straight to its final place on disk, so only one chunk is ever in
+// memory. The entry stays ENTRY_RESERVED, and no lock is held, while the
+// body arrives. Downloads likewise take the entry's stripe lock per chunk
+// rather than across network writes.
+
+void begin_file_upload(OFSystem& fs_instance, const std::string& path, uint64_t size, FileUpload& upload, const AccessContext& caller) {
+    LockManager& locks = *fs_instance.lock_manager;
+    std::string parent_path = "/"; std::string filename = path;
+    size_t last_slash = path.find_last_of('/');
+    if (last_slash != std::string::npos) {
+        parent_path = path.substr(0, last_slash);
+        if (parent_path.empty()) parent_path = "/";
+        filename = path.substr(last_slash + 1);
+    }
+    if (filename.empty()) throw OFSException(OFS_ERROR_INVALID_PATH, "Invalid file path");
+    check_name_length(fs_instance, filename);
+    int parent_index = resolve_path(fs_instance, parent_path, caller, PERM_WRITE);
+    if (parent_index == -1) throw OFSException(OFS_ERROR_NOT_FOUND, "Parent directory not found");
+    LockManager::Guard guard = locks.lock_entries({(uint32_t)parent_index}, true);
+
+    int free_entry_index;
+    int free_block_index;
+    MetadataEntry new_file = {};
+    {
+        std::unique_lock<std::shared_mutex> ns(locks.namespace_lock());
+        if (!entry_is_directory(fs_instance, parent_index)) throw OFSException(OFS_ERROR_NOT_FOUND, "Parent directory not found");
+        std::lock_guard<std::mutex> alloc(locks.allocator_lock());
+        free_entry_index = find_free_metadata_entry(fs_instance);
+        if (free_entry_index == -1) throw OFSException(OFS_ERROR_NO_SPACE, "No free metadata entries");
+        uint32_t block_count = blocks_for_size(fs_instance, size);
+        free_block_index = find_free_extent(fs_instance, block_count);
+        if (free_block_index == -1) throw OFSException(OFS_ERROR_NO_SPACE, "Not enough contiguous free space");
+        charge_quota(fs_instance, caller.uid, size, 1);
+        mark_extent(fs_instance, free_block_index, block_count, false);
+        new_file.validity_flag = 0; new_file.type_flag = 0; new_file.parent_index = parent_index;
+        strncpy(new_file.short_name, filename.c_str(), sizeof(new_file.short_name) - 1);
+        new_file.total_size = size; new_file.start_index = free_block_index;
+        new_file.owner_id = caller.uid; new_file.permissions = DEFAULT_FILE_PERMISSIONS;
+        new_file.created_time = time(nullptr); new_file.modified_time = time(nullptr);
+        fs_instance.metadata_entries[free_entry_index] = new_file;
+        fs_instance.metadata_entries[free_entry_index].validity_flag = ENTRY_RESERVED;
+        fs_instance.entry_generations[free_entry_index] = ++fs_instance.next_entry_generation;
+    }
+    upload.entry_index = free_entry_index;
+    upload.parent_index = parent_index;
+    upload.entry = new_file;
+    upload.written = 0;
+}
+
+// Appends the next chunk. Returns false on an I/O error or if the chunk would
+// run past the size given to begin_file_upload.
+bool write_file_upload(OFSystem& fs_instance, FileUpload& upload, const char* data, size_t length) {
+    if (upload.written + length > upload.entry.total_size) return false;
+    uint64_t offset = data_block_offset(fs_instance, upload.entry.start_index) + upload.written;
+    if (!container_io(fs_instance, true, offset, const_cast<char*>(data), length)) return false;
+    upload.written += length;
+    return true;
+}
+
+task<bool> write_file_upload_async(OFSystem& fs_instance, FileUpload& upload, const char* data, size_t length) {
+    if (upload.written + length > upload.entry.total_size) co_return false;
+    uint64_t offset = data_block_offset(fs_instance, upload.entry.start_index) + upload.written;
+    bool written = co_await container_io_async(fs_instance, true, offset, const_cast<char*>(data), length);
+    if (!written) co_return false;
+    upload.written += length;
+    co_return true;
+}
+
+void finish_file_upload(OFSystem& fs_instance, FileUpload& upload) {
+    if (upload.written != upload.entry.total_size) {
+        abort_file_upload(fs_instance, upload);
+        throw OFSException(OFS_ERROR_IO_ERROR, "Upload ended before the declared size");
+    }
+    // The parent's stripe keeps it from being removed between the check and the publish.
+    LockManager::Guard guard = fs_instance.lock_manager->lock_entries({upload.parent_index}, true);
+    bool parent_alive;
+    {
+        std::shared_lock<std::shared_mutex> ns(fs_instance.lock_manager->namespace_lock());
+        parent_alive = entry_is_directory(fs_instance, upload.parent_index);
+    }
+    if (!parent_alive) {
+        release_entry(fs_instance, upload.entry_index, upload.entry, true);
+        throw OFSException(OFS_ERROR_NOT_FOUND, "Parent directory was removed during the upload");
+    }
+    publish_entry(fs_instance, upload.entry_index, upload.entry);
+}
+
+void abort_file_upload(OFSystem& fs_instance, FileUpload& upload) {
+    release_entry(fs_instance, upload.entry_index, upload.entry, true);
+}
+
+void begin_file_download(OFSystem& fs_instance, const std::string& path, FileDownload& download, const AccessContext& caller) {
+    LockManager& locks = *fs_instance.lock_manager;
+    int entry_index = resolve_path(fs_instance, path, caller, 0);
+    if (entry_index == -1) throw OFSException(OFS_ERROR_NOT_FOUND, "File not found");
+    LockManager::Guard guard = locks.lock_entries({(uint32_t)entry_index}, false);
+    {
+        std::shared_lock<std::shared_mutex> ns(locks.namespace_lock());
+        download.entry = fs_instance.metadata_entries[entry_index];
+        download.generation = fs_instance.entry_generations[entry_index];
+        if (download.entry.validity_flag != 0) throw OFSException(OFS_ERROR_NOT_FOUND, "File not found");
+        if (download.entry.type_flag == 1) throw OFSException(OFS_ERROR_INVALID_OPERATION, "Cannot read a directory");
+        require_access(fs_instance, caller, entry_index, PERM_READ);
+    }
+    download.entry_index = entry_index;
+}
+
+// Reads up to `length` bytes at `offset`. Returns the number of bytes read, or
+// 0 once the file has been removed, replaced or truncated since the start.
+size_t read_file_download(OFSystem& fs_instance, FileDownload& download, uint64_t offset, char* buffer, size_t length) {
+    if (offset >= download.entry.total_size) return 0;
+    length = std::min<uint64_t>(length, download.entry.total_size - offset);
+    LockManager& locks = *fs_instance.lock_manager;
+    LockManager::Guard guard = locks.lock_entries({download.entry_index}, false);
+    {
+        std::shared_lock<std::shared_mutex> ns(locks.namespace_lock());
+        const MetadataEntry& current = fs_instance.metadata_entries[download.entry_index];
+        if (current.validity_flag != 0 || current.start_index != download.entry.start_index ||
+            fs_instance.entry_generations[download.entry_index] != download.generation ||
+            current.total_size < offset + length) {
+            return 0;
+        }
+    }
+    uint64_t position = data_block_offset(fs_instance, download.entry.start_index) + offset;
+    if (!container_io(fs_instance, false, position, buffer, length)) return 0;
+    return length;
+}
+
+// Checks an in-place edit and pins the extent it writes into. The bytes are
+// then written with no lock held; finish_file_edit stamps the entry.
+void begin_file_edit(OFSystem& fs_instance, const std::string& path, uint32_t index, size_t length, FileEdit& edit, const AccessContext& caller) {
+    LockManager& locks = *fs_instance.lock_manager;
+    int entry_index = resolve_path(fs_instance, path, caller, 0);
+    if (entry_index == -1) throw OFSException(OFS_ERROR_NOT_FOUND, "File not found");
+    LockManager::Guard guard = locks.lock_entries({(uint32_t)entry_index}, false);
+    {
+        std::shared_lock<std::shared_mutex> ns(locks.namespace_lock());
+        edit.entry = fs_instance.metadata_entries[entry_index];
+        edit.generation = fs_instance.entry_generations[entry_index];
+        if (edit.entry.validity_flag != 0) throw OFSException(OFS_ERROR_NOT_FOUND, "File not found");
+        if (edit.entry.type_flag == 1) throw OFSException(OFS_ERROR_INVALID_OPERATION, "Cannot edit a directory");
+        require_access(fs_instance, caller, entry_index, PERM_WRITE);
+        if ((uint64_t)index + length > edit.entry.total_size) throw OFSException(OFS_ERROR_INVALID_OPERATION, "Edit exceeds the original file size");
+        std::lock_guard<std::mutex> alloc(locks.allocator_lock());
+        fs_instance.extent_pins[edit.entry.start_index]++;
+    }
+    edit.entry_index = entry_index;
+    edit.position = data_block_offset(fs_instance, edit.entry.start_index) + index;
+}
+
+// Updates the modification time, unless the file was removed or replaced
+// while its bytes were being written, and releases the pin.
+void finish_file_edit(OFSystem& fs_instance, FileEdit& edit) {
+    LockManager& locks = *fs_instance.lock_manager;
+    {
+        LockManager::Guard guard = locks.lock_entries({edit.entry_index}, true);
+        MetadataEntry& current = fs_instance.metadata_entries[edit.entry_index];
+        bool unchanged;
+        {
+            std::shared_lock<std::shared_mutex> ns(locks.namespace_lock());
+            unchanged = current.validity_flag == 0 && current.start_index == edit.entry.start_index &&
+                        fs_instance.entry_generations[edit.entry_index] == edit.generation;
+        }
+        if (unchanged) {
+            current.modified_time = time(nullptr);
+            persist_metadata_entry(fs_instance, edit.entry_index, current);
+        }
+    }
+    unpin_file_extent(fs_instance, edit.entry.start_index);
+}
+
+void abort_file_edit(OFSystem& fs_instance, FileEdit& edit) {
+    unpin_file_extent(fs_instance, edit.entry.start_index);
+}
+
+// Pins the file's extent and returns where its bytes are, so the socket
+// server can sendfile() them after every lock is released. Removing or
+// truncating the file meanwhile is allowed; only the reuse of its blocks
+// waits for unpin_file_extent.
+FileExtent pin_file_extent(OFSystem& fs_instance, const std::string& path, const AccessContext& caller) {
+    LockManager& locks = *fs_instance.lock_manager;
+    int entry_index = resolve_path(fs_instance, path, caller, 0);
+    if (entry_index == -1) throw OFSException(OFS_ERROR_NOT_FOUND, "File not found");
+    LockManager::Guard guard = locks.lock_entries({(uint32_t)entry_index}, false);
+    MetadataEntry entry;
+    {
+        std::shared_lock<std::shared_mutex> ns(locks.namespace_lock());
+        entry = fs_instance.metadata_entries[entry_index];
+        if (entry.validity_flag != 0) throw OFSException(OFS_ERROR_NOT_FOUND, "File not found");
+        if (entry.type_flag == 1) throw OFSException(OFS_ERROR_INVALID_OPERATION, "Cannot read a directory");
+        require_access(fs_instance, caller, entry_index, PERM_READ);
+        std::lock_guard<std::mutex> alloc(locks.allocator_lock());
+        fs_instance.extent_pins[entry.start_index]++;
+    }
+    return {fs_instance.omni_fd, data_block_offset(fs_instance, entry.start_index), entry.total_size, entry.start_index};
+}
+
+void unpin_file_extent(OFSystem& fs_instance, uint32_t start_block) {
+    std::lock_guard<std::mutex> alloc(fs_instance.lock_manager->allocator_lock());
+    auto pin = fs_instance.extent_pins.find(start_block);
+    if (pin == fs_instance.extent_pins.end() || --pin->second > 0) { return; }
+    fs_instance.extent_pins.erase(pin);
+    auto deferred = fs_instance.deferred_extent_frees.equal_range(start_block);
+    for (auto it = deferred.first; it != deferred.second; ++it) {
+        mark_extent(fs_instance, it->second.first, it->second.second, true);
+    }
+    fs_instance.deferred_extent_frees.erase(deferred.first, deferred.second);
+}
+
+// ============================================================================
+// QUOTAS
+// ============================================================================
+uint32_t user_id_of(OFSystem& fs_instance, const UserInfo* user) {
+    return static_cast<uint32_t>(user - fs_instance.user_table.data());
+}
+
+UserQuota get_user_quota(const UserInfo& user) {
+    UserQuota quota = {};
+    memcpy(&quota.max_bytes, user.reserved, sizeof(quota.max_bytes));
+    memcpy(&quota.max_inodes, user.reserved + sizeof(quota.max_bytes), sizeof(quota.max_inodes));
+    return quota;
+}
+
+void set_user_quota(OFSystem& fs_instance, const std::string& username, const UserQuota& quota) {
+    UserInfo* user = user_map_get(fs_instance.user_map, username);
+    if (user == nullptr || user->is_active != 1) { throw OFSException(OFS_ERROR_NOT_FOUND, "User '" + username + "' not found"); }
+    memcpy(user->reserved, &quota.max_bytes, sizeof(quota.max_bytes));
+    memcpy(user->reserved + sizeof(quota.max_bytes), &quota.max_inodes, sizeof(quota.max_inodes));
+    uint32_t user_slot = user_id_of(fs_instance, user);
     std::fstream file(fs_instance.omni_filepath, std::ios::in | std::ios::out | std::ios::binary);
-    long position = fs_instance.header.file_state_storage_offset + (entry_index * sizeof(MetadataEntry));
-    file.seekp(position);
-    file.write(reinterpret_cast<const char*>(&entry), sizeof(MetadataEntry));
+    file.seekp(fs_instance.header.user_table_offset + (user_slot * sizeof(UserInfo)));
+    file.write(reinterpret_cast<const char*>(user), sizeof(UserInfo));
+    file.close();
+}
+
+UserUsage get_user_usage(OFSystem& fs_instance, uint32_t user_id) {
+    std::lock_guard<std::mutex> alloc(fs_instance.lock_manager->allocator_lock());
+    if (user_id >= fs_instance.user_usage.size()) { return {}; }
+    return fs_instance.user_usage[user_id];
+}
+
+// Batched metadata writes. The caller holds g_fs_mutex exclusively for the
+// whole batch, so entries may be published before they reach disk.
+void begin_metadata_batch(OFSystem& fs_instance) {
+    fs_instance.metadata_batch_open = true;
+}
+
+// Writes every entry touched since begin_metadata_batch() with one open and
+// one write per run of adjacent slots; an entry touched twice is written once.
+void end_metadata_batch(OFSystem& fs_instance) {
+    fs_instance.metadata_batch_open = false;
+    if (fs_instance.pending_metadata.empty()) return;
+    std::fstream file(fs_instance.omni_filepath, std::ios::in | std::ios::out | std::ios::binary);
+    std::vector<MetadataEntry> run;
+    uint32_t run_start = 0;
+    auto write_run = [&]() {
+        if (run.empty()) return;
+        file.seekp(fs_instance.header.file_state_storage_offset + (run_start * sizeof(MetadataEntry)));
+        file.write(reinterpret_cast<const char*>(run.data()), run.size() * sizeof(MetadataEntry));
+        run.clear();
+    };
+    for (const auto& pending : fs_instance.pending_metadata) {
+        if (!run.empty() && pending.first != run_start + run.size()) write_run();
+        if (run.empty()) run_start = pending.first;
+        run.push_back(pending.second);
+    }
+    write_run();
     file.close();
+    fs_instance.pending_metadata.clear();
 }
 
 std::string get_error_string(int error_code) {
@@ -453,41 +1050,133 @@ int find_free_metadata_entry(OFSystem& fs_instance) {
     for (size_t i = 1; i < fs_instance.metadata_entries.size(); ++i) {
         if (fs_instance.metadata_entries[i].validity_flag == 1) { return i; }
     }
-    std::cerr << "Error: No free metadata entries available!" << std::endl;
+    LOG_WARN("No free metadata entries available");
     return -1;
 }
 
-int find_free_block(OFSystem& fs_instance) {
+// Empty files still hold one block so start_index always points at their own.
+uint32_t blocks_for_size(const OFSystem& fs_instance, uint64_t size) {
+    if (size == 0) { return 1; }
+    return (uint32_t)((size - 1) / fs_instance.header.block_size + 1);
+}
+
+// First fit over the free map. Block 0 is never handed out.
+int find_free_extent(OFSystem& fs_instance, uint32_t block_count) {
+    size_t run_start = 1;
+    size_t run_length = 0;
     for (size_t i = 1; i < fs_instance.free_block_map.size(); ++i) {
-        if (fs_instance.free_block_map[i] == true) { return i; }
+        if (!fs_instance.free_block_map[i]) { run_length = 0; continue; }
+        if (run_length == 0) { run_start = i; }
+        if (++run_length == block_count) { return run_start; }
     }
-    std::cerr << "Error: No free data blocks available!" << std::endl;
+    LOG_WARN("No contiguous run of free data blocks").kv("blocks", block_count);
     return -1;
 }
 
-int find_entry_by_path(OFSystem& fs_instance, const std::string& path) {
-    if (path == "/" || path.empty()) { return 0; }
-    std::vector<std::string> segments;
-    std::string temp_path = path;
-    if (temp_path[0] == '/') { temp_path = temp_path.substr(1); }
-    if (!temp_path.empty() && temp_path.back() == '/') { temp_path.pop_back(); }
-    
-    std::stringstream ss(temp_path);
-    std::string segment;
-    while(std::getline(ss, segment, '/')) {
-       if (!segment.empty()) { segments.push_back(segment); }
+void mark_extent(OFSystem& fs_instance, uint32_t start_block, uint32_t block_count, bool is_free) {
+    size_t end = std::min<size_t>((size_t)start_block + block_count, fs_instance.free_block_map.size());
+    for (size_t i = start_block; i < end; ++i) { fs_instance.free_block_map[i] = is_free; }
+}
+
+// Caller holds the allocator lock. While the file starting at file_start is
+// pinned for a zero-copy send, its blocks must not be handed to another file.
+void free_extent(OFSystem& fs_instance, uint32_t file_start, uint32_t start_block, uint32_t block_count) {
+    if (block_count == 0) { return; }
+    if (fs_instance.extent_pins.count(file_start)) {
+        fs_instance.deferred_extent_frees.insert({file_start, {start_block, block_count}});
+        return;
     }
-    
-    if (segments.empty()) { return 0; }
-    
+    mark_extent(fs_instance, start_block, block_count, true);
+}
+
+uint64_t data_block_offset(const OFSystem& fs_instance, uint32_t block_index) {
+    uint64_t data_area_start = fs_instance.header.file_state_storage_offset + (fs_instance.metadata_entries.size() * sizeof(MetadataEntry));
+    return data_area_start + ((uint64_t)block_index * fs_instance.header.block_size);
+}
+
+// File content moves through the I/O backend in pieces of this size, all
+// submitted at once, so a multi-block transfer keeps the device busy instead
+// of waiting on each piece in turn.
+const size_t CONTAINER_IO_CHUNK = 64 * 1024;
+
+static std::vector<IoRequest> container_requests(OFSystem& fs_instance, bool is_write, uint64_t offset, char* buffer, size_t length) {
+    std::vector<IoRequest> requests;
+    requests.reserve(length / CONTAINER_IO_CHUNK + 1);
+    for (size_t done = 0; done < length; done += CONTAINER_IO_CHUNK) {
+        size_t piece = std::min(CONTAINER_IO_CHUNK, length - done);
+        requests.push_back(is_write ? IoRequest::write(fs_instance.omni_fd, offset + done, buffer + done, piece)
+                                    : IoRequest::read(fs_instance.omni_fd, offset + done, buffer + done, piece));
+    }
+    return requests;
+}
+
+static bool transferred_fully(const std::vector<IoRequest>& requests) {
+    for (const IoRequest& request : requests) {
+        if (request.result != (ssize_t)request.length) { return false; }
+    }
+    return true;
+}
+
+// Reads or writes `length` bytes of the container at `offset`. Returns false
+// on an error or short transfer.
+bool container_io(OFSystem& fs_instance, bool is_write, uint64_t offset, char* buffer, size_t length) {
+    std::vector<IoRequest> requests = container_requests(fs_instance, is_write, offset, buffer, length);
+    fs_instance.io_backend->submit_and_wait(requests.data(), requests.size());
+    return transferred_fully(requests);
+}
+
+task<bool> container_io_async(OFSystem& fs_instance, bool is_write, uint64_t offset, char* buffer, size_t length) {
+    std::vector<IoRequest> requests = container_requests(fs_instance, is_write, offset, buffer, length);
+    co_await fs_instance.io_backend->transfer(requests.data(), requests.size());
+    co_return transferred_fully(requests);
+}
+
+// Entries written before permissions were enforced carry 0; treat them as the
+// default mode for their type instead of locking everyone out.
+uint32_t effective_permissions(const MetadataEntry& entry) {
+    if (entry.permissions != 0) { return entry.permissions; }
+    return (entry.type_flag == 1) ? DEFAULT_DIR_PERMISSIONS : DEFAULT_FILE_PERMISSIONS;
+}
+
+// `wanted` is given in the "others" position (PERM_READ/WRITE/EXECUTE); the
+// owner class is selected by shifting, so the check is one mask test.
+bool has_access(const AccessContext& caller, const MetadataEntry& entry, uint32_t wanted) {
+    if (caller.role == 1) { return true; }
+    uint32_t shift = (entry.owner_id == caller.uid) ? PERM_OWNER_SHIFT : 0;
+    return ((effective_permissions(entry) >> shift) & wanted) == wanted;
+}
+
+void require_access(OFSystem& fs_instance, const AccessContext& caller, uint32_t entry_index, uint32_t wanted) {
+    if (!has_access(caller, fs_instance.metadata_entries[entry_index], wanted)) {
+        throw OFSException(OFS_ERROR_PERMISSION_DENIED, "Permission denied");
+    }
+}
+
+// When `caller` is given, every directory walked through must grant it execute
+// permission; the check rides along with the lookup instead of a second pass.
+int find_entry_by_path(OFSystem& fs_instance, const std::string& path, const AccessContext* caller) {
+    // Walks the segments in place rather than splitting the path into
+    // strings, since this runs under the namespace lock.
+    size_t pos = path.find_first_not_of('/');
+    if (pos == std::string::npos) { return 0; }
+
     int current_parent_index = 0;
-    for (size_t i = 0; i < segments.size(); ++i) {
-        const std::string& current_segment = segments[i];
+    while (pos != std::string::npos) {
+        size_t end = path.find('/', pos);
+        if (end == std::string::npos) { end = path.size(); }
+        size_t length = end - pos;
+        const char* segment = path.c_str() + pos;
+        pos = path.find_first_not_of('/', end);
+        bool is_last = (pos == std::string::npos);
+        if (length >= sizeof(MetadataEntry::short_name)) { return -1; }
+
+        if (caller != nullptr) { require_access(fs_instance, *caller, current_parent_index, PERM_EXECUTE); }
         bool found_next = false;
         for (size_t j = 1; j < fs_instance.metadata_entries.size(); ++j) {
             const auto& entry = fs_instance.metadata_entries[j];
-            if (entry.validity_flag == 0 && entry.parent_index == (uint32_t)current_parent_index && strcmp(entry.short_name, current_segment.c_str()) == 0) {
-                if (i == segments.size() - 1) { return j; }
+            if (entry.validity_flag == 0 && entry.parent_index == (uint32_t)current_parent_index &&
+                strncmp(entry.short_name, segment, length) == 0 && entry.short_name[length] == '\0') {
+                if (is_last) { return j; }
                 if (entry.type_flag == 1) {
                     current_parent_index = j;
                     found_next = true;
@@ -500,6 +1189,90 @@ int find_entry_by_path(OFSystem& fs_instance, const std::string& path) {
     return -1;
 }
 
+// Resolves `path` under a shared namespace lock and checks `wanted` on the
+// result. The caller must re-validate the entry after locking its stripes.
+int resolve_path(OFSystem& fs_instance, const std::string& path, const AccessContext& caller, uint32_t wanted, uint32_t* parent_index) {
+    std::shared_lock<std::shared_mutex> ns(fs_instance.lock_manager->namespace_lock());
+    int entry_index = find_entry_by_path(fs_instance, path, &caller);
+    if (entry_index == -1) { return -1; }
+    if (wanted != 0) { require_access(fs_instance, caller, entry_index, wanted); }
+    if (parent_index != nullptr) { *parent_index = fs_instance.metadata_entries[entry_index].parent_index; }
+    return entry_index;
+}
+
+// Caller holds the namespace lock.
+bool entry_is_directory(OFSystem& fs_instance, uint32_t entry_index) {
+    const MetadataEntry& entry = fs_instance.metadata_entries[entry_index];
+    return entry.validity_flag == 0 && entry.type_flag == 1;
+}
+
+void persist_metadata_entry(OFSystem& fs_instance, uint32_t entry_index, const MetadataEntry& entry) {
+    if (fs_instance.metadata_batch_open) {
+        fs_instance.pending_metadata[entry_index] = entry;
+        return;
+    }
+    std::fstream file(fs_instance.omni_filepath, std::ios::in | std::ios::out | std::ios::binary);
+    long position = fs_instance.header.file_state_storage_offset + (entry_index * sizeof(MetadataEntry));
+    file.seekp(position);
+    file.write(reinterpret_cast<const char*>(&entry), sizeof(MetadataEntry));
+    file.close();
+}
+
+// Second half of a create: the entry is written to disk while the slot is
+// still reserved, so nothing else can touch it, and only then made visible.
+void publish_entry(OFSystem& fs_instance, uint32_t entry_index, const MetadataEntry& entry) {
+    persist_metadata_entry(fs_instance, entry_index, entry);
+    std::unique_lock<std::shared_mutex> ns(fs_instance.lock_manager->namespace_lock());
+    fs_instance.metadata_entries[entry_index].validity_flag = 0;
+}
+
+// Second half of a remove: once the freed entry is on disk, return its extent
+// and quota and make the slot available to the allocator again.
+void release_entry(OFSystem& fs_instance, uint32_t entry_index, const MetadataEntry& removed, bool free_blocks) {
+    LockManager& locks = *fs_instance.lock_manager;
+    std::unique_lock<std::shared_mutex> ns(locks.namespace_lock());
+    std::lock_guard<std::mutex> alloc(locks.allocator_lock());
+    if (free_blocks) {
+        free_extent(fs_instance, removed.start_index, removed.start_index, blocks_for_size(fs_instance, removed.total_size));
+    }
+    release_quota(fs_instance, removed.owner_id, removed.total_size, 1);
+    fs_instance.metadata_entries[entry_index].validity_flag = 1;
+}
+
+// Counters are only rebuilt here, after an unclean stop (a clean one saves
+// them with the free map); every mutation afterwards adjusts them in place.
+void rebuild_user_usage(OFSystem& fs_instance) {
+    fs_instance.user_usage.assign(fs_instance.user_table.size(), UserUsage{});
+    for (size_t i = 1; i < fs_instance.metadata_entries.size(); ++i) {
+        const auto& entry = fs_instance.metadata_entries[i];
+        if (entry.validity_flag == 0 && entry.owner_id < fs_instance.user_usage.size()) {
+            fs_instance.user_usage[entry.owner_id].bytes_used += entry.total_size;
+            fs_instance.user_usage[entry.owner_id].inode_count++;
+        }
+    }
+}
+
+void charge_quota(OFSystem& fs_instance, uint32_t owner_id, uint64_t bytes, uint32_t inodes) {
+    if (owner_id >= fs_instance.user_usage.size()) { return; }
+    UserUsage& usage = fs_instance.user_usage[owner_id];
+    UserQuota quota = get_user_quota(fs_instance.user_table[owner_id]);
+    if (quota.max_bytes != 0 && usage.bytes_used + bytes > quota.max_bytes) {
+        throw OFSException(OFS_ERROR_NO_SPACE, "Storage quota exceeded");
+    }
+    if (quota.max_inodes != 0 && usage.inode_count + inodes > quota.max_inodes) {
+        throw OFSException(OFS_ERROR_NO_SPACE, "File count quota exceeded");
+    }
+    usage.bytes_used += bytes;
+    usage.inode_count += inodes;
+}
+
+void release_quota(OFSystem& fs_instance, uint32_t owner_id, uint64_t bytes, uint32_t inodes) {
+    if (owner_id >= fs_instance.user_usage.size()) { return; }
+    UserUsage& usage = fs_instance.user_usage[owner_id];
+    usage.bytes_used = (usage.bytes_used > bytes) ? usage.bytes_used - bytes : 0;
+    usage.inode_count = (usage.inode_count > inodes) ? usage.inode_count - inodes : 0;
+}
+
 std::string generate_session_id() {
     std::string id;
     static const char alphanum[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
@@ -510,4 +1283,34 @@ std::string generate_session_id() {
         id += alphanum[distrib(gen)];
     }
     return id;
-}
\ No newline at end of file
+}
+
+// normalize_path() only enforces the short_name size every container shares;
+// the container's own, possibly shorter, limit applies when a name is created.
+void check_name_length(const OFSystem& fs_instance, const std::string& name) {
+    size_t limit = fs_instance.header.max_filename_length;
+    if (limit == 0 || limit >= sizeof(MetadataEntry::short_name)) { limit = sizeof(MetadataEntry::short_name) - 1; }
+    if (name.size() > limit) {
+        throw OFSException(OFS_ERROR_INVALID_PATH, "Name '" + name + "' is longer than " + std::to_string(limit) + " characters");
+    }
+}
+
+std::string normalize_path(const std::string& path) {
+    std::string normalized;
+    normalized.reserve(path.size() + 1);
+    size_t pos = 0;
+    while (pos < path.size()) {
+        size_t end = path.find('/', pos);
+        if (end == std::string::npos) { end = path.size(); }
+        if (end > pos) {
+            if (end - pos >= sizeof(MetadataEntry::short_name)) {
+                throw OFSException(OFS_ERROR_INVALID_PATH, "Name '" + path.substr(pos, end - pos) + "' is longer than " +
+                                   std::to_string(sizeof(MetadataEntry::short_name) - 1) + " characters");
+            }
+            normalized += '/';
+            normalized.append(path, pos, end - pos);
+        }
+        pos = end + 1;
+    }
+    return normalized.empty() ? "/" : normalized;
+}
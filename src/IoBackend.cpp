@@ -0,0 +1,301 @@
+#include "../include/IoBackend.h"
+#include "../include/Log.h"
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <condition_variable>
+
+// Requests from concurrent callers share the ring; completions are matched
+// back through user_data, which points at the Pending (or WAKE_TAG).
+static const uint64_t WAKE_TAG = 0;
+
+// A synchronous batch lives on its caller's stack and is signalled through
+// done. An async one is heap-allocated, owns its Pending entries and is only
+// touched by the submitter once queued; it is freed when it completes.
+struct IoBackend::Batch {
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t remaining;
+    std::coroutine_handle<> continuation;
+    std::vector<Pending> pending;
+};
+
+static unsigned load_acquire(const unsigned* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static void store_release(unsigned* p, unsigned v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+IoBackend::IoBackend(bool try_io_uring, unsigned queue_depth, unsigned resume_threads) {
+    if (!try_io_uring) return;
+    if (!setup_ring(queue_depth)) {
+        teardown_ring();
+        LOG_INFO("io_uring unavailable; using synchronous container I/O");
+        return;
+    }
+    m_submitter = std::thread(&IoBackend::submitter_loop, this);
+    for (unsigned i = 0; i < resume_threads; ++i) m_resumers.emplace_back(&IoBackend::resume_loop, this);
+}
+
+IoBackend::~IoBackend() {
+    if (m_submitter.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        uint64_t one = 1;
+        if (write(m_wake_fd, &one, sizeof(one)) < 0) {}
+        m_submitter.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_ready_mutex);
+        m_resumers_stopping = true;
+    }
+    m_ready_cv.notify_all();
+    for (std::thread& resumer : m_resumers) resumer.join();
+    teardown_ring();
+}
+
+bool IoBackend::setup_ring(unsigned queue_depth) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    m_ring_fd = (int)syscall(__NR_io_uring_setup, queue_depth, &params);
+    if (m_ring_fd < 0) return false;
+    m_sq_entries = params.sq_entries;
+
+    m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+
+    m_sq_ring = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQ_RING);
+    if (m_sq_ring == MAP_FAILED) { m_sq_ring = nullptr; return false; }
+    if (single_mmap) {
+        m_cq_ring = m_sq_ring;
+    } else {
+        m_cq_ring = mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_CQ_RING);
+        if (m_cq_ring == MAP_FAILED) { m_cq_ring = nullptr; return false; }
+    }
+    void* sqes = mmap(nullptr, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) return false;
+    m_sqes = (struct io_uring_sqe*)sqes;
+
+    char* sq = (char*)m_sq_ring;
+    m_sq_head = (unsigned*)(sq + params.sq_off.head);
+    m_sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    m_sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    m_sq_array = (unsigned*)(sq + params.sq_off.array);
+    char* cq = (char*)m_cq_ring;
+    m_cq_head = (unsigned*)(cq + params.cq_off.head);
+    m_cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    m_cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    m_cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    m_wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (m_wake_fd < 0) return false;
+
+    // IORING_OP_READ on the eventfd is how callers wake the submitter; kernels
+    // too old for it (< 5.6) get the synchronous path instead.
+    uint64_t one = 1;
+    if (write(m_wake_fd, &one, sizeof(one)) < 0) return false;
+    arm_wakeup();
+    if (enter(1, 1) < 0) return false;
+    unsigned head = *m_cq_head;
+    if (head == load_acquire(m_cq_tail)) return false;
+    int result = m_cqes[head & *m_cq_mask].res;
+    store_release(m_cq_head, head + 1);
+    return result == (int)sizeof(uint64_t);
+}
+
+void IoBackend::teardown_ring() {
+    if (m_sqes != nullptr) munmap(m_sqes, m_sq_entries * sizeof(struct io_uring_sqe));
+    if (m_cq_ring != nullptr && m_cq_ring != m_sq_ring) munmap(m_cq_ring, m_cq_ring_size);
+    if (m_sq_ring != nullptr) munmap(m_sq_ring, m_sq_ring_size);
+    if (m_ring_fd >= 0) close(m_ring_fd);
+    if (m_wake_fd >= 0) close(m_wake_fd);
+    m_sqes = nullptr;
+    m_sq_ring = m_cq_ring = nullptr;
+    m_ring_fd = m_wake_fd = -1;
+}
+
+int IoBackend::enter(unsigned to_submit, unsigned min_complete) {
+    while (true) {
+        int ret = (int)syscall(__NR_io_uring_enter, m_ring_fd, to_submit, min_complete,
+                               min_complete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        if (ret >= 0 || errno != EINTR) return ret;
+    }
+}
+
+// Only the submitter thread (or setup, before it starts) touches the SQ.
+static struct io_uring_sqe* next_sqe(struct io_uring_sqe* sqes, unsigned* head, unsigned* tail,
+                                     unsigned* mask, unsigned* array, unsigned entries) {
+    unsigned t = *tail;
+    if (t - load_acquire(head) >= entries) return nullptr;
+    unsigned index = t & *mask;
+    struct io_uring_sqe* sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    array[index] = index;
+    return sqe;
+}
+
+void IoBackend::arm_wakeup() {
+    struct io_uring_sqe* sqe = next_sqe(m_sqes, m_sq_head, m_sq_tail, m_sq_mask, m_sq_array, m_sq_entries);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = m_wake_fd;
+    sqe->addr = (uint64_t)(uintptr_t)&m_wake_value;
+    sqe->len = sizeof(m_wake_value);
+    sqe->off = 0;
+    sqe->user_data = WAKE_TAG;
+    store_release(m_sq_tail, *m_sq_tail + 1);
+}
+
+bool IoBackend::queue_sqe(Pending* pending) {
+    // One SQE stays free for re-arming the wakeup read.
+    if (m_in_flight + 1 >= m_sq_entries) return false;
+    struct io_uring_sqe* sqe = next_sqe(m_sqes, m_sq_head, m_sq_tail, m_sq_mask, m_sq_array, m_sq_entries);
+    if (sqe == nullptr) return false;
+    IoRequest& request = *pending->request;
+    sqe->opcode = request.is_write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = request.fd;
+    sqe->addr = (uint64_t)(uintptr_t)(request.buffer + pending->done);
+    sqe->len = (uint32_t)std::min<size_t>(request.length - pending->done, 1u << 30);
+    sqe->off = request.offset + pending->done;
+    sqe->user_data = (uint64_t)(uintptr_t)pending;
+    store_release(m_sq_tail, *m_sq_tail + 1);
+    m_in_flight++;
+    return true;
+}
+
+/**
+ * @brief The submitter: gathers requests, submits them together and reaps
+ * completions. A read on the eventfd is always in flight, so a single
+ * blocking io_uring_enter() waits for both new work and finished I/O.
+ */
+void IoBackend::submitter_loop() {
+    arm_wakeup();
+    unsigned queued = 1;
+    while (true) {
+        if (enter(queued, 1) < 0 && errno != EBUSY) {
+            LOG_ERROR("io_uring_enter failed").kv("error", strerror(errno));
+        }
+        queued = 0;
+
+        bool woken = false;
+        unsigned head = *m_cq_head;
+        while (head != load_acquire(m_cq_tail)) {
+            struct io_uring_cqe* cqe = &m_cqes[head & *m_cq_mask];
+            uint64_t tag = cqe->user_data;
+            int result = cqe->res;
+            store_release(m_cq_head, ++head);
+
+            if (tag == WAKE_TAG) { woken = true; continue; }
+            m_in_flight--;
+            Pending* pending = (Pending*)(uintptr_t)tag;
+            IoRequest& request = *pending->request;
+            if (result > 0) pending->done += result;
+            if (result == -EAGAIN || result == -EINTR ||
+                (result > 0 && pending->done < request.length)) {
+                m_backlog.push_back(pending);  // Continue a short transfer
+                continue;
+            }
+            request.result = (result < 0) ? result : (ssize_t)pending->done;
+            Batch* batch = pending->batch;
+            if (batch->continuation) {
+                if (--batch->remaining > 0) continue;
+                {
+                    std::lock_guard<std::mutex> lock(m_ready_mutex);
+                    m_ready.push_back(batch->continuation);
+                }
+                m_ready_cv.notify_one();
+                delete batch;
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            if (--batch->remaining == 0) batch->done.notify_one();
+        }
+
+        bool stopping = false;
+        if (woken) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_backlog.insert(m_backlog.end(), m_incoming.begin(), m_incoming.end());
+            m_incoming.clear();
+            stopping = m_stopping;
+        }
+        if (stopping && m_in_flight == 0 && m_backlog.empty()) return;
+        if (woken) {
+            arm_wakeup();
+            queued++;
+        }
+        while (!m_backlog.empty() && queue_sqe(m_backlog.front())) {
+            m_backlog.pop_front();
+            queued++;
+        }
+    }
+}
+
+void IoBackend::run_sync(IoRequest& request) {
+    size_t done = 0;
+    while (done < request.length) {
+        ssize_t n = request.is_write
+            ? pwrite(request.fd, request.buffer + done, request.length - done, request.offset + done)
+            : pread(request.fd, request.buffer + done, request.length - done, request.offset + done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) { request.result = -errno; return; }
+        if (n == 0) break;
+        done += n;
+    }
+    request.result = (ssize_t)done;
+}
+
+void IoBackend::submit_and_wait(IoRequest* requests, size_t count) {
+    if (count == 0) return;
+    if (!uses_io_uring()) {
+        for (size_t i = 0; i < count; ++i) run_sync(requests[i]);
+        return;
+    }
+
+    Batch batch;
+    enqueue(batch, requests, count);
+    std::unique_lock<std::mutex> lock(batch.mutex);
+    batch.done.wait(lock, [&batch] { return batch.remaining == 0; });
+}
+
+void IoBackend::submit_async(IoRequest* requests, size_t count, std::coroutine_handle<> continuation) {
+    Batch* batch = new Batch();
+    batch->continuation = continuation;
+    enqueue(*batch, requests, count);
+}
+
+// Hands the requests to the submitter; the batch may complete (and an async
+// one be freed) before this returns.
+void IoBackend::enqueue(Batch& batch, IoRequest* requests, size_t count) {
+    batch.remaining = count;
+    batch.pending.resize(count);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < count; ++i) {
+            batch.pending[i] = {&requests[i], &batch, 0};
+            m_incoming.push_back(&batch.pending[i]);
+        }
+    }
+    uint64_t one = 1;
+    if (write(m_wake_fd, &one, sizeof(one)) < 0) {}
+}
+
+void IoBackend::resume_loop() {
+    while (true) {
+        std::coroutine_handle<> next;
+        {
+            std::unique_lock<std::mutex> lock(m_ready_mutex);
+            m_ready_cv.wait(lock, [this] { return m_resumers_stopping || !m_ready.empty(); });
+            if (m_ready.empty()) return;
+            next = m_ready.front();
+            m_ready.pop_front();
+        }
+        next.resume();
+    }
+}
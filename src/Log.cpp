@@ -0,0 +1,299 @@
+#include "../include/Log.h"
+
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+
+std::atomic<uint8_t> g_log_level{(uint8_t)LogLevel::Info};
+
+static const char* const LEVEL_NAMES[] = {"debug", "info", "warn", "error", "off"};
+
+bool parse_log_level(const std::string& text, LogLevel& out) {
+    for (uint8_t i = 0; i <= (uint8_t)LogLevel::Off; ++i) {
+        if (text == LEVEL_NAMES[i]) { out = (LogLevel)i; return true; }
+    }
+    return false;
+}
+
+// ============================================================================
+// PER-THREAD RINGS
+// ============================================================================
+// Single producer (the owning thread), single consumer (the writer). head and
+// tail only grow; a position's byte is data[pos % CAPACITY]. Each record is a
+// RecordHeader followed by its text, and may wrap around the end of data.
+
+struct RecordHeader {
+    uint64_t timestamp_ns;   // CLOCK_REALTIME
+    uint32_t length;         // Bytes of text after the header
+    uint8_t level;
+};
+
+struct LogRing {
+    static const size_t CAPACITY = 128 * 1024;   // Power of two
+
+    char data[CAPACITY];
+    alignas(64) std::atomic<uint64_t> head{0};   // Written by the owning thread
+    alignas(64) std::atomic<uint64_t> tail{0};   // Written by the writer
+    std::atomic<uint64_t> dropped{0};            // Records that did not fit
+    uint64_t dropped_reported = 0;               // Writer's view of `dropped`
+    unsigned thread_id = 0;
+
+    void copy_in(uint64_t pos, const void* source, size_t length) {
+        size_t offset = pos & (CAPACITY - 1);
+        size_t first = std::min(length, CAPACITY - offset);
+        memcpy(data + offset, source, first);
+        memcpy(data, (const char*)source + first, length - first);
+    }
+
+    void copy_out(uint64_t pos, void* target, size_t length) const {
+        size_t offset = pos & (CAPACITY - 1);
+        size_t first = std::min(length, CAPACITY - offset);
+        memcpy(target, data + offset, first);
+        memcpy((char*)target + first, data, length - first);
+    }
+};
+
+static std::mutex g_rings_mutex;
+static std::vector<LogRing*> g_rings;
+static thread_local LogRing* t_ring = nullptr;
+
+static std::mutex g_writer_mutex;
+static std::condition_variable g_writer_wake;
+static std::thread g_writer;
+static bool g_stopping = false;
+static int g_log_fd = STDERR_FILENO;
+
+static const std::chrono::milliseconds FLUSH_INTERVAL(25);
+
+// Rings outlive their threads so nothing logged is lost; like the metric
+// shards, there are only as many as the server's long-lived threads.
+static LogRing& local_ring() {
+    if (t_ring == nullptr) {
+        t_ring = new LogRing();
+        std::lock_guard<std::mutex> lock(g_rings_mutex);
+        t_ring->thread_id = (unsigned)g_rings.size() + 1;
+        g_rings.push_back(t_ring);
+    }
+    return *t_ring;
+}
+
+static void push_record(LogLevel level, const char* text, uint32_t length) {
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    RecordHeader header{(uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec, length, (uint8_t)level};
+
+    LogRing& ring = local_ring();
+    const size_t needed = sizeof(header) + length;
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    uint64_t used = head - ring.tail.load(std::memory_order_acquire);
+    if (LogRing::CAPACITY - used < needed) {
+        ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    ring.copy_in(head, &header, sizeof(header));
+    ring.copy_in(head + sizeof(header), text, length);
+    ring.head.store(head + needed, std::memory_order_release);
+
+    // The writer polls on FLUSH_INTERVAL; wake it early for errors and before
+    // a busy ring fills.
+    bool crossed_half = used <= LogRing::CAPACITY / 2 && used + needed > LogRing::CAPACITY / 2;
+    if (level >= LogLevel::Error || crossed_half) g_writer_wake.notify_one();
+}
+
+// ============================================================================
+// RECORD FORMATTING
+// ============================================================================
+
+LogRecord::LogRecord(LogLevel level, std::string_view message) : m_level(level) {
+    append("msg=");
+    append_value(message);
+}
+
+LogRecord::~LogRecord() {
+    push_record(m_level, m_text, m_length);
+}
+
+void LogRecord::append(std::string_view text) {
+    size_t length = std::min(text.size(), MAX_TEXT - m_length);
+    memcpy(m_text + m_length, text.data(), length);
+    m_length += (uint32_t)length;
+}
+
+// Quotes values that are empty or contain spaces, '=' or quotes, escaping
+// quotes, backslashes and control characters so one record stays one line.
+void LogRecord::append_value(std::string_view value) {
+    bool quote = value.empty();
+    for (char c : value) {
+        if (c == ' ' || c == '=' || c == '"' || c == '\\' || (unsigned char)c < 0x20) { quote = true; break; }
+    }
+    if (!quote) { append(value); return; }
+
+    append("\"");
+    for (char c : value) {
+        if (c == '"') append("\\\"");
+        else if (c == '\\') append("\\\\");
+        else if (c == '\n') append("\\n");
+        else if ((unsigned char)c < 0x20) append("?");
+        else append(std::string_view(&c, 1));
+    }
+    append("\"");
+}
+
+LogRecord& LogRecord::kv(const char* key, std::string_view value) {
+    append(" ");
+    append(key);
+    append("=");
+    append_value(value);
+    return *this;
+}
+
+LogRecord& LogRecord::kv_signed(const char* key, long long value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    return kv(key, std::string_view(digits, result.ptr - digits));
+}
+
+LogRecord& LogRecord::kv_unsigned(const char* key, unsigned long long value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    return kv(key, std::string_view(digits, result.ptr - digits));
+}
+
+// ============================================================================
+// WRITER
+// ============================================================================
+
+struct PendingRecord {
+    uint64_t timestamp_ns;
+    uint8_t level;
+    unsigned thread_id;
+    size_t offset;           // Into the batch's text buffer
+    uint32_t length;
+};
+
+static void append_timestamp(std::string& out, uint64_t timestamp_ns) {
+    time_t seconds = (time_t)(timestamp_ns / 1000000000ULL);
+    tm utc;
+    gmtime_r(&seconds, &utc);
+    char text[40];
+    size_t length = strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &utc);
+    snprintf(text + length, sizeof(text) - length, ".%06uZ", (unsigned)(timestamp_ns % 1000000000ULL / 1000));
+    out += text;
+}
+
+static void write_all(const std::string& out) {
+    size_t written = 0;
+    while (written < out.size()) {
+        ssize_t n = write(g_log_fd, out.data() + written, out.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;   // Nowhere left to report it
+        written += (size_t)n;
+    }
+}
+
+// Empties every ring and writes the records, oldest first, in one write().
+// Only the writer thread (or log_stop() after joining it) calls this.
+static void drain_rings() {
+    static std::string text;
+    static std::string out;
+    static std::vector<PendingRecord> pending;
+    text.clear();
+    out.clear();
+    pending.clear();
+
+    std::vector<LogRing*> rings;
+    {
+        std::lock_guard<std::mutex> lock(g_rings_mutex);
+        rings = g_rings;
+    }
+    for (LogRing* ring : rings) {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        while (tail < head) {
+            RecordHeader header;
+            ring->copy_out(tail, &header, sizeof(header));
+            size_t offset = text.size();
+            text.resize(offset + header.length);
+            ring->copy_out(tail + sizeof(header), &text[offset], header.length);
+            pending.push_back({header.timestamp_ns, header.level, ring->thread_id, offset, header.length});
+            tail += sizeof(header) + header.length;
+        }
+        ring->tail.store(tail, std::memory_order_release);
+
+        uint64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+        if (dropped != ring->dropped_reported) {
+            std::string note = "msg=\"Log ring full; records dropped\" count=" + std::to_string(dropped - ring->dropped_reported);
+            ring->dropped_reported = dropped;
+            timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            size_t offset = text.size();
+            text += note;
+            pending.push_back({(uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec, (uint8_t)LogLevel::Warn,
+                               ring->thread_id, offset, (uint32_t)note.size()});
+        }
+    }
+    if (pending.empty()) return;
+
+    std::stable_sort(pending.begin(), pending.end(),
+                     [](const PendingRecord& a, const PendingRecord& b) { return a.timestamp_ns < b.timestamp_ns; });
+    for (const PendingRecord& record : pending) {
+        out += "ts=";
+        append_timestamp(out, record.timestamp_ns);
+        out += " level=";
+        out += LEVEL_NAMES[std::min<uint8_t>(record.level, (uint8_t)LogLevel::Off)];
+        out += " thread=";
+        out += std::to_string(record.thread_id);
+        out += ' ';
+        out.append(text, record.offset, record.length);
+        out += '\n';
+    }
+    write_all(out);
+}
+
+static void writer_loop() {
+    std::unique_lock<std::mutex> lock(g_writer_mutex);
+    while (!g_stopping) {
+        g_writer_wake.wait_for(lock, FLUSH_INTERVAL);
+        lock.unlock();
+        drain_rings();
+        lock.lock();
+    }
+}
+
+bool log_start(const LogConfig& config, std::string& error) {
+    if (!config.file.empty()) {
+        int fd = open(config.file.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            error = "cannot open log file " + config.file + ": " + strerror(errno);
+            return false;
+        }
+        g_log_fd = fd;
+    }
+    g_log_level.store((uint8_t)config.level, std::memory_order_relaxed);
+    g_writer = std::thread(writer_loop);
+    return true;
+}
+
+void log_stop() {
+    {
+        std::lock_guard<std::mutex> lock(g_writer_mutex);
+        g_stopping = true;
+    }
+    g_writer_wake.notify_one();
+    if (g_writer.joinable()) g_writer.join();
+    drain_rings();
+    if (g_log_fd != STDERR_FILENO) {
+        fdatasync(g_log_fd);
+        close(g_log_fd);
+        g_log_fd = STDERR_FILENO;
+    }
+}
@@ -1,89 +1,241 @@
 #include <iostream>
 #include <thread>
 #include <mutex>
+#include <shared_mutex>
 #include <fstream>
+#include <csignal>
+#include <cstdlib>
+#include <functional>
 
 #include "../include/httplib.h"
 #include "../include/json.hpp"
 #include "../include/OFSTypes.h"
 #include "../include/FileSystem.h"
+#include "../include/Config.h"
 #include "../include/UserMap.h"
+#include "../include/RateLimiter.h"
+#include "../include/Server.h"
+#include "../include/BinaryProtocol.h"
+#include "../include/OperationTable.h"
+#include "../include/OperationParams.h"
+#include "../include/Task.h"
+#include "../include/Metrics.h"
+#include "../include/Log.h"
 
 using json = nlohmann::json;
 
 OFSystem g_FileSystem;
-std::mutex g_fs_mutex;
+// Operations that touch the user table or session map take this exclusively.
+// File and directory operations take it shared and rely on the LockManager
+// in FileSystem.cpp for per-entry locking, so they run in parallel on
+// httplib's thread pool.
+std::shared_mutex g_fs_mutex;
+httplib::Server* g_server = nullptr;
 
-// Helper to check admin privileges
-bool check_admin(const std::string& sid) {
-    if (sid.empty()) return false;
-    auto it = g_FileSystem.active_sessions.find(sid);
-    return (it != g_FileSystem.active_sessions.end() && it->second->role == 1);
+// Budgets are checked before g_fs_mutex so a flooding client is turned away
+// without ever queueing on the filesystem lock.
+RateLimiter g_session_limiter({200, 100}, {50, 20});
+RateLimiter g_ip_limiter({400, 200}, {100, 40});
+
+// Read operations draw on the cheaper rate-limit budget.
+bool is_read_operation(const std::string& op) {
+    const OperationInfo* info = find_operation(op);
+    return info != nullptr && (info->flags & OP_READ);
 }
 
-json handle_ofs_logic(json req) {
-    json resp;
-    std::string op = req["operation"];
-    resp["operation"] = op;
-
-    // --- 1. AUTHENTICATION ---
-    if (op == "user_login") {
-        std::string u = req["parameters"]["username"];
-        std::string p = req["parameters"]["password"];
-        std::string sid = login_user(g_FileSystem, u, p);
-        if (!sid.empty()) {
-            resp["status"] = "success";
-            resp["data"]["session_id"] = sid;
-            SessionInfo info = get_session_details(g_FileSystem, sid);
-            resp["data"]["is_admin"] = (info.role == 1);
-            resp["data"]["username"] = info.username;
-        } else {
-            resp["status"] = "error";
-            resp["error_message"] = "Invalid credentials";
-        }
-        return resp;
-    }
+bool is_account_operation(const std::string& op) {
+    const OperationInfo* info = find_operation(op);
+    return info != nullptr && (info->flags & OP_ACCOUNT);
+}
+
+// Returns 0 when the request may proceed, otherwise the suggested retry delay in ms.
+long check_rate_limit(const std::string& remote_addr, const std::string& op, const std::string& sid) {
+    bool is_write = !is_read_operation(op);
+    long retry_ms = g_ip_limiter.try_acquire(remote_addr, is_write);
+    if (retry_ms > 0 || sid.empty()) return retry_ms;
+    retry_ms = g_session_limiter.try_acquire(sid, is_write);
+    if (retry_ms > 0) g_ip_limiter.refund(remote_addr, is_write);
+    return retry_ms;
+}
+
+long check_rate_limit(const std::string& remote_addr, const json& req) {
+    return check_rate_limit(remote_addr, req.value("operation", ""), session_id_of(req));
+}
+
+// SIGTERM/SIGINT and fs_shutdown stop the HTTP listener; main() then drains
+// the socket server and flushes the filesystem before exiting.
+void handle_stop_signal(int) {
+    if (g_server) g_server->stop();
+}
 
-    // Check Session for all other commands
-    std::string sid = req.value("session_id", "");
-    if (g_FileSystem.active_sessions.find(sid) == g_FileSystem.active_sessions.end()) {
-        resp["status"] = "error";
-        resp["error_message"] = "Session expired or invalid";
-        return resp;
+// The caller of one operation, looked up under g_fs_mutex just before it
+// runs. Empty for OP_NO_SESSION operations.
+struct OperationContext {
+    std::string sid;
+    ActiveSession* session = nullptr;
+    AccessContext caller = {};
+    bool is_admin = false;
+    StageTimes* times = nullptr;  // The request's stage clock, see Metrics.h
+};
+
+// Takes `lock`, charging the wait to the request's lock_wait stage.
+template <typename Lock>
+void lock_timed(Lock& lock, StageTimes& times) {
+    StageClock wait(times, Stage::LockWait);
+    lock.lock();
+}
+
+// Runs one synchronous step of a coroutine handler under a shared g_fs_mutex.
+// The lock belongs to the thread that took it, so a handler releases it
+// before every co_await and takes it again for its next step.
+template <typename Step>
+auto with_shared_fs_lock(OperationContext& ctx, Step&& step) {
+    std::shared_lock<std::shared_mutex> lock(g_fs_mutex, std::defer_lock);
+    lock_timed(lock, *ctx.times);
+    StageClock clock(*ctx.times, Stage::Execute);
+    return step();
+}
+
+// Awaits a container transfer, charging its wall time to the io stage.
+task<bool> timed_io(OperationContext& ctx, task<bool> transfer) {
+    uint64_t start = monotonic_ns();
+    bool done = co_await transfer;
+    ctx.times->add(Stage::Io, monotonic_ns() - start);
+    co_return done;
+}
+
+// --- Operations ---
+// Each operation names its Params (see OperationParams.h), runs against the filesystem under
+// g_fs_mutex and returns a plain Result, which render() turns into the JSON
+// response after the lock is released. Failures are thrown as OFSException.
+//
+// Operations that move file content also define run_async, a coroutine that
+// takes g_fs_mutex only for its begin and finish steps and awaits the data
+// transfer with no lock held. Their run() is kept for batches, which execute
+// everything under one exclusive lock.
+struct Done {};
+
+// For operations whose response is just {"status": "success"}.
+template <typename P>
+struct SimpleOperation {
+    typedef P Params;
+    typedef Done Result;
+    static void render(const Params&, Done&, json&) {}
+};
+
+// --- 1. AUTHENTICATION ---
+struct UserLoginOp {
+    typedef LoginParams Params;
+    struct Result { std::string sid; SessionInfo info; };
+    static Result run(const Params& p, OperationContext&) {
+        std::string sid = login_user(g_FileSystem, p.username, p.password);
+        if (sid.empty()) throw OFSException(OFS_ERROR_PERMISSION_DENIED, "Invalid credentials");
+        return {sid, get_session_details(g_FileSystem, sid)};
     }
+    static void render(const Params&, Result& r, json& resp) {
+        resp["data"]["session_id"] = r.sid;
+        resp["data"]["is_admin"] = (r.info.role == 1);
+        resp["data"]["username"] = r.info.username;
+    }
+};
+
+struct UserLogoutOp : SimpleOperation<NoParams> {
+    static Done run(const Params&, OperationContext& ctx) { logout_user(g_FileSystem, ctx.sid); return {}; }
+};
 
-    bool is_admin = check_admin(sid);
+// --- 2. USER MANAGEMENT ---
+struct UserListOp {
+    typedef NoParams Params;
+    typedef std::vector<std::string> Result;
+    static Result run(const Params&, OperationContext&) { return list_all_users(g_FileSystem); }
+    static void render(const Params&, Result& users, json& resp) { resp["data"]["users"] = users; }
+};
 
-    // --- 2. USER MANAGEMENT (Admin Only) ---
-    if (op == "user_list") {
-        if (!is_admin) return {{"status", "error"}, {"error_message", "Admin required"}};
-        resp["status"] = "success";
-        resp["data"]["users"] = list_all_users(g_FileSystem);
+struct UserCreateOp : SimpleOperation<NewUserParams> {
+    static Done run(const Params& p, OperationContext&) {
+        create_user(g_FileSystem, p.user.username, p.user.password, p.user.role);
+        return {};
     }
-    else if (op == "user_create") {
-        if (!is_admin) return {{"status", "error"}, {"error_message", "Admin required"}};
-        create_user(g_FileSystem, req["parameters"]["username"], req["parameters"]["password"], req["parameters"].value("role", 0));
-        resp["status"] = "success";
+};
+
+struct UserCreateBatchOp {
+    typedef UserBatchParams Params;
+    typedef std::vector<int32_t> Result;
+    static Result run(const Params& p, OperationContext&) { return create_users_batch(g_FileSystem, p.users); }
+    static void render(const Params& p, Result& codes, json& resp) {
+        json results = json::array();
+        for (size_t i = 0; i < codes.size(); ++i) {
+            results.push_back({{"username", p.users[i].username}, {"status", codes[i] == OFS_SUCCESS ? "success" : "error"}, {"error_code", codes[i]}});
+        }
+        resp["data"]["results"] = results;
     }
-    else if (op == "user_delete") {
-        if (!is_admin) return {{"status", "error"}, {"error_message", "Admin required"}};
-        delete_user(g_FileSystem, req["parameters"]["username"]);
-        resp["status"] = "success";
+};
+
+struct UserDeleteOp : SimpleOperation<UsernameParams> {
+    static Done run(const Params& p, OperationContext&) { delete_user(g_FileSystem, p.username); return {}; }
+};
+
+struct UserSetQuotaOp : SimpleOperation<SetQuotaParams> {
+    static Done run(const Params& p, OperationContext&) { set_user_quota(g_FileSystem, p.username, p.quota); return {}; }
+};
+
+struct GetUserQuotaOp {
+    typedef QuotaQueryParams Params;
+    struct Result { std::string username; UserQuota quota; UserUsage usage; };
+    static Result run(const Params& p, OperationContext& ctx) {
+        UserInfo* user = ctx.session->user;
+        std::string target = p.username.empty() ? std::string(user->username) : p.username;
+        if (target != user->username) {
+            if (!ctx.is_admin) throw OFSException(OFS_ERROR_PERMISSION_DENIED, "Admin required");
+            user = user_map_get(g_FileSystem.user_map, target);
+            if (user == nullptr || user->is_active != 1) throw OFSException(OFS_ERROR_NOT_FOUND, "User not found");
+        }
+        return {target, get_user_quota(*user), get_user_usage(g_FileSystem, user_id_of(g_FileSystem, user))};
     }
-    else if (op == "user_logout") {
-        logout_user(g_FileSystem, sid);
-        resp["status"] = "success";
+    static void render(const Params&, Result& r, json& resp) {
+        resp["data"] = {
+            {"username", r.username},
+            {"max_bytes", r.quota.max_bytes},
+            {"max_files", r.quota.max_inodes},
+            {"bytes_used", r.usage.bytes_used},
+            {"file_count", r.usage.inode_count}
+        };
     }
+};
+
+// --- 3. SYSTEM ---
+struct FsShutdownOp : SimpleOperation<NoParams> {
+    // The shutdown starts in execute_prepared once the response is built
+    static Done run(const Params&, OperationContext&) { return {}; }
+};
 
-    // --- 3. SYSTEM ---
-    else if (op == "fs_shutdown") {
-        if (!is_admin) return {{"status", "error"}, {"error_message", "Admin required"}};
-        resp["status"] = "success";
-        // We will handle the actual exit in main() after sending response
+struct GetServerStatsOp {
+    typedef NoParams Params;
+    typedef Done Result;
+    static Done run(const Params&, OperationContext&) { return {}; }
+    // The counters are atomics, so they are read after the lock is released.
+    static void render(const Params&, Done&, json& resp) {
+        uint64_t processed = g_server_metrics.processed;
+        resp["data"] = {
+            {"accepted", g_server_metrics.accepted.load()},
+            {"active_connections", g_server_metrics.active_connections.load()},
+            {"queue_depth", g_server_metrics.queue_depth.load()},
+            {"in_flight", g_server_metrics.in_flight.load()},
+            {"rejected_connections", g_server_metrics.rejected_connections.load()},
+            {"rejected_queue_full", g_server_metrics.rejected_queue_full.load()},
+            {"timed_out", g_server_metrics.timed_out.load()},
+            {"processed", processed},
+            {"avg_wait_us", processed ? g_server_metrics.total_wait_us.load() / processed : 0},
+            {"max_wait_us", g_server_metrics.max_wait_us.load()}
+        };
     }
-    else if (op == "get_fs_stats") {
-        FSStats stats = get_fs_stats(g_FileSystem);
-        resp["status"] = "success";
+};
+
+struct GetFsStatsOp {
+    typedef NoParams Params;
+    typedef FSStats Result;
+    static Result run(const Params&, OperationContext&) { return get_fs_stats(g_FileSystem); }
+    static void render(const Params&, Result& stats, json& resp) {
         resp["data"] = {
             {"total_size", stats.total_size},
             {"used_space", stats.used_space},
@@ -92,57 +244,96 @@ json handle_ofs_logic(json req) {
             {"dir_count", stats.directory_count}
         };
     }
+};
 
-    // --- 4. DIRECTORY OPERATIONS ---
-    else if (op == "list_directory_contents") {
-        std::string path = req["parameters"]["path"];
-        auto entries = list_directory_contents(g_FileSystem, path);
+// --- 4. DIRECTORY OPERATIONS ---
+struct ListDirectoryContentsOp {
+    typedef PathParams Params;
+    typedef std::vector<DirEntryInfo> Result;
+    static Result run(const Params& p, OperationContext& ctx) { return list_directory_contents(g_FileSystem, p.path, ctx.caller); }
+    static void render(const Params&, Result& entries, json& resp) {
         json list = json::array();
         for (const auto& e : entries) list.push_back({{"name", e.name}, {"is_directory", e.is_directory}});
-        resp["status"] = "success";
         resp["data"] = list;
     }
-    else if (op == "dir_create") {
-        create_directory(g_FileSystem, req["parameters"]["path"]);
-        resp["status"] = "success";
-    }
-    else if (op == "remove_directory") {
-        remove_directory(g_FileSystem, req["parameters"]["path"]);
-        resp["status"] = "success";
-    }
-    
-    // --- 5. FILE OPERATIONS ---
-    else if (op == "create_file_with_content") {
-        create_file_with_content(g_FileSystem, req["parameters"]["path"], req["parameters"]["data"]);
-        resp["status"] = "success";
-    }
-    else if (op == "file_read") {
-        std::string content = read_file_content(g_FileSystem, req["parameters"]["path"]);
-        resp["status"] = "success";
-        resp["data"]["content"] = content;
-    }
-    else if (op == "edit_file") {
-        // Calls edit_file directly
-        edit_file(g_FileSystem, req["parameters"]["path"], req["parameters"]["data"], req["parameters"]["index"]);
-        resp["status"] = "success";
-    }
-    else if (op == "truncate_file_content") {
-        truncate_file_content(g_FileSystem, req["parameters"]["path"]);
-        resp["status"] = "success";
+};
+
+struct DirCreateOp : SimpleOperation<PathParams> {
+    static Done run(const Params& p, OperationContext& ctx) { create_directory(g_FileSystem, p.path, ctx.caller); return {}; }
+};
+
+struct RemoveDirectoryOp : SimpleOperation<PathParams> {
+    static Done run(const Params& p, OperationContext& ctx) { remove_directory(g_FileSystem, p.path, ctx.caller); return {}; }
+};
+
+// --- 5. FILE OPERATIONS ---
+struct CreateFileWithContentOp : SimpleOperation<ContentParams> {
+    static Done run(const Params& p, OperationContext& ctx) { create_file_with_content(g_FileSystem, p.path, p.data, ctx.caller); return {}; }
+    static task<Done> run_async(const Params& p, OperationContext& ctx) {
+        FileUpload upload;
+        with_shared_fs_lock(ctx, [&] { begin_file_upload(g_FileSystem, p.path, p.data.length(), upload, ctx.caller); });
+        bool written = co_await timed_io(ctx, write_file_upload_async(g_FileSystem, upload, p.data.data(), p.data.length()));
+        with_shared_fs_lock(ctx, [&] {
+            if (!written) {
+                abort_file_upload(g_FileSystem, upload);
+                throw OFSException(OFS_ERROR_IO_ERROR, "Failed to write file content");
+            }
+            finish_file_upload(g_FileSystem, upload);
+        });
+        co_return Done{};
     }
-    else if (op == "remove_file") {
-        remove_file(g_FileSystem, req["parameters"]["path"]);
-        resp["status"] = "success";
+};
+
+struct FileReadOp {
+    typedef PathParams Params;
+    typedef std::string Result;
+    static Result run(const Params& p, OperationContext& ctx) { return read_file_content(g_FileSystem, p.path, ctx.caller); }
+    static task<Result> run_async(const Params& p, OperationContext& ctx) {
+        FileExtent extent = with_shared_fs_lock(ctx, [&] { return pin_file_extent(g_FileSystem, p.path, ctx.caller); });
+        ExtentPin pin(g_FileSystem, extent);
+        std::string content(extent.length, '\0');
+        bool read = co_await timed_io(ctx, container_io_async(g_FileSystem, false, extent.offset, content.data(), content.size()));
+        if (!read) throw OFSException(OFS_ERROR_IO_ERROR, "Failed to read file content");
+        co_return content;
     }
-    else if (op == "rename_path") {
-        rename_path(g_FileSystem, req["parameters"]["old_path"], req["parameters"]["new_path"]);
-        resp["status"] = "success";
+    static void render(const Params&, Result& content, json& resp) { resp["data"]["content"] = std::move(content); }
+};
+
+struct EditFileOp : SimpleOperation<EditParams> {
+    static Done run(const Params& p, OperationContext& ctx) { edit_file(g_FileSystem, p.path, p.data, p.index, ctx.caller); return {}; }
+    static task<Done> run_async(const Params& p, OperationContext& ctx) {
+        FileEdit edit;
+        with_shared_fs_lock(ctx, [&] { begin_file_edit(g_FileSystem, p.path, p.index, p.data.length(), edit, ctx.caller); });
+        bool written = co_await timed_io(ctx, container_io_async(g_FileSystem, true, edit.position, const_cast<char*>(p.data.data()), p.data.length()));
+        with_shared_fs_lock(ctx, [&] {
+            if (!written) {
+                abort_file_edit(g_FileSystem, edit);
+                throw OFSException(OFS_ERROR_IO_ERROR, "Failed to write file content");
+            }
+            finish_file_edit(g_FileSystem, edit);
+        });
+        co_return Done{};
     }
+};
+
+struct TruncateFileContentOp : SimpleOperation<PathParams> {
+    static Done run(const Params& p, OperationContext& ctx) { truncate_file_content(g_FileSystem, p.path, ctx.caller); return {}; }
+};
 
-    // --- 6. METADATA & PERMISSIONS ---
-    else if (op == "get_path_metadata") {
-        FileMetadata meta = get_path_metadata(g_FileSystem, req["parameters"]["path"]);
-        resp["status"] = "success";
+struct RemoveFileOp : SimpleOperation<PathParams> {
+    static Done run(const Params& p, OperationContext& ctx) { remove_file(g_FileSystem, p.path, ctx.caller); return {}; }
+};
+
+struct RenamePathOp : SimpleOperation<RenameParams> {
+    static Done run(const Params& p, OperationContext& ctx) { rename_path(g_FileSystem, p.old_path, p.new_path, ctx.caller); return {}; }
+};
+
+// --- 6. METADATA & PERMISSIONS ---
+struct GetPathMetadataOp {
+    typedef PathParams Params;
+    typedef FileMetadata Result;
+    static Result run(const Params& p, OperationContext& ctx) { return get_path_metadata(g_FileSystem, p.path, ctx.caller); }
+    static void render(const Params&, Result& meta, json& resp) {
         resp["data"] = {
             {"name", meta.name},
             {"size", meta.size},
@@ -153,54 +344,713 @@ json handle_ofs_logic(json req) {
             {"is_directory", meta.is_directory}
         };
     }
-    else if (op == "set_path_permissions") {
-        set_path_permissions(g_FileSystem, req["parameters"]["path"], req["parameters"]["permissions"]);
-        resp["status"] = "success";
+};
+
+struct SetPathPermissionsOp : SimpleOperation<PermissionParams> {
+    static Done run(const Params& p, OperationContext& ctx) { set_path_permissions(g_FileSystem, p.path, p.permissions, ctx.caller); return {}; }
+};
+
+// A request split into the three phases above. prepare_operation() fills it
+// without any lock, run_prepared() is the only part that needs g_fs_mutex,
+// and finish_operation() builds the response once the lock is released.
+struct PreparedOperation {
+    const OperationInfo* info = nullptr;
+    std::string sid;
+    json response;          // Holds "operation" and, once failed, the error
+    bool failed = false;
+    StageTimes times;
+    std::function<void(OperationContext&)> run;
+    std::function<task<void>(OperationContext&)> run_async;  // Empty unless Op has one
+    std::function<void(json&)> render;
+};
+
+void fail_operation(PreparedOperation& op, int32_t code, const std::string& message) {
+    op.failed = true;
+    op.response["status"] = "error";
+    op.response["error_code"] = code;
+    op.response["error_message"] = message;
+}
+
+// Not a lambda: a coroutine lambda's captures die with the std::function
+// holding it, while this frame keeps its own reference to the state.
+template <typename Op, typename State>
+task<void> await_operation(std::shared_ptr<State> state, OperationContext& ctx) {
+    state->result = co_await Op::run_async(state->params, ctx);
+}
+
+template <typename Op>
+void bind_operation(PreparedOperation& prepared, const json& params) {
+    struct State {
+        typename Op::Params params;
+        typename Op::Result result;
+    };
+    auto state = std::make_shared<State>(State{Op::Params::decode(params), typename Op::Result()});
+    prepared.run = [state](OperationContext& ctx) { state->result = Op::run(state->params, ctx); };
+    if constexpr (requires { &Op::run_async; }) {
+        prepared.run_async = [state](OperationContext& ctx) { return await_operation<Op>(state, ctx); };
+    }
+    prepared.render = [state](json& resp) { Op::render(state->params, state->result, resp); };
+}
+
+typedef void (*OperationBinder)(PreparedOperation& prepared, const json& params);
+
+struct OperationEntry {
+    OperationId id;
+    OperationBinder bind;
+};
+
+// Indexed by OperationId; see OPERATIONS in OperationTable.h for names and flags.
+constexpr OperationEntry OPERATION_HANDLERS[] = {
+    {OperationId::UserLogin,             bind_operation<UserLoginOp>},
+    {OperationId::UserLogout,            bind_operation<UserLogoutOp>},
+    {OperationId::UserList,              bind_operation<UserListOp>},
+    {OperationId::UserCreate,            bind_operation<UserCreateOp>},
+    {OperationId::UserCreateBatch,       bind_operation<UserCreateBatchOp>},
+    {OperationId::UserDelete,            bind_operation<UserDeleteOp>},
+    {OperationId::UserSetQuota,          bind_operation<UserSetQuotaOp>},
+    {OperationId::GetUserQuota,          bind_operation<GetUserQuotaOp>},
+    {OperationId::FsShutdown,            bind_operation<FsShutdownOp>},
+    {OperationId::GetServerStats,        bind_operation<GetServerStatsOp>},
+    {OperationId::GetFsStats,            bind_operation<GetFsStatsOp>},
+    {OperationId::ListDirectoryContents, bind_operation<ListDirectoryContentsOp>},
+    {OperationId::DirCreate,             bind_operation<DirCreateOp>},
+    {OperationId::RemoveDirectory,       bind_operation<RemoveDirectoryOp>},
+    {OperationId::CreateFileWithContent, bind_operation<CreateFileWithContentOp>},
+    {OperationId::FileRead,              bind_operation<FileReadOp>},
+    {OperationId::EditFile,              bind_operation<EditFileOp>},
+    {OperationId::TruncateFileContent,   bind_operation<TruncateFileContentOp>},
+    {OperationId::RemoveFile,            bind_operation<RemoveFileOp>},
+    {OperationId::RenamePath,            bind_operation<RenamePathOp>},
+    {OperationId::GetPathMetadata,       bind_operation<GetPathMetadataOp>},
+    {OperationId::SetPathPermissions,    bind_operation<SetPathPermissionsOp>},
+};
+
+constexpr bool handlers_in_order() {
+    if (sizeof(OPERATION_HANDLERS) / sizeof(OPERATION_HANDLERS[0]) != OPERATION_COUNT) return false;
+    for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+        if ((size_t)OPERATION_HANDLERS[i].id != i) return false;
+    }
+    return true;
+}
+static_assert(handlers_in_order(), "OPERATION_HANDLERS must have one entry per OperationId, in order");
+
+// Looks the operation up in the perfect-hash table and decodes its
+// parameters. Touches no filesystem state, so it runs before any lock.
+PreparedOperation prepare_operation(const json& req) {
+    PreparedOperation op;
+    auto name = req.find("operation");
+    if (name != req.end() && name->is_string()) {
+        op.response["operation"] = *name;
+        op.info = find_operation(name->get_ref<const std::string&>());
+    }
+    if (op.info == nullptr) {
+        op.failed = true;
+        op.response["status"] = "error";
+        op.response["error_message"] = "Unknown Operation";
+        return op;
+    }
+    op.sid = session_id_of(req);
+
+    try {
+        OPERATION_HANDLERS[(size_t)op.info->id].bind(op, parameters_of(req));
+    }
+    catch (OFSException& e) {
+        fail_operation(op, e.code, e.what());
     }
-    else {
-        resp["status"] = "error";
-        resp["error_message"] = "Unknown Operation";
+    catch (std::exception& e) {
+        fail_operation(op, OFS_ERROR_INVALID_OPERATION, e.what());
     }
+    return op;
+}
 
+// Looks up the caller under g_fs_mutex. Returns false, with the operation
+// failed, for a bad session or a non-admin calling an admin operation.
+bool open_context(PreparedOperation& op, OperationContext& ctx) {
+    if (op.info->flags & OP_NO_SESSION) return true;
+    ctx.sid = op.sid;
+    ctx.session = find_active_session(g_FileSystem, ctx.sid);
+    if (ctx.session == nullptr) { fail_operation(op, OFS_ERROR_INVALID_SESSION, "Session expired or invalid"); return false; }
+    ctx.caller = ctx.session->access;
+    ctx.is_admin = (ctx.caller.role == 1);
+    if ((op.info->flags & OP_ADMIN) && !ctx.is_admin) { fail_operation(op, OFS_ERROR_PERMISSION_DENIED, "Admin required"); return false; }
+    return true;
+}
+
+// The part of a request that must hold g_fs_mutex: the session lookup and
+// the filesystem call itself.
+void run_prepared(PreparedOperation& op) {
+    if (op.failed) return;
+    StageClock clock(op.times, Stage::Execute);
+    OperationContext ctx;
+    ctx.times = &op.times;
+    if (!open_context(op, ctx)) return;
+    try {
+        op.run(ctx);
+    }
+    catch (OFSException& e) {
+        fail_operation(op, e.code, e.what());
+    }
+    catch (std::exception& e) {
+        fail_operation(op, OFS_ERROR_IO_ERROR, e.what());
+    }
+}
+
+// Builds the response; called after g_fs_mutex has been released. This is
+// the request's last stage, so its times are recorded here.
+json finish_operation(PreparedOperation& op) {
+    if (!op.failed) {
+        StageClock clock(op.times, Stage::Serialize);
+        op.response["status"] = "success";
+        op.render(op.response);
+    }
+    if (op.info != nullptr) record_stages(op.info->id, op.times);
+    return std::move(op.response);
+}
+
+// Runs a prepared operation synchronously, holding the right level of
+// g_fs_mutex only while it touches the filesystem.
+json execute_prepared(PreparedOperation& op) {
+    {
+        if (op.info == nullptr || !(op.info->flags & OP_ACCOUNT)) {
+            std::shared_lock<std::shared_mutex> lock(g_fs_mutex, std::defer_lock);
+            lock_timed(lock, op.times);
+            run_prepared(op);
+        } else {
+            std::unique_lock<std::shared_mutex> lock(g_fs_mutex, std::defer_lock);
+            lock_timed(lock, op.times);
+            run_prepared(op);
+        }
+    }
+
+    // Only starts the shutdown: this reply, and every other request already
+    // accepted, still completes before main() flushes and exits.
+    if (!op.failed && op.info->id == OperationId::FsShutdown) {
+        handle_stop_signal(0);
+    }
+    return finish_operation(op);
+}
+
+// Runs one decoded request. Operations with a run_async suspend while their
+// file content is on its way to or from disk, freeing the calling thread;
+// the rest complete without suspending. The session pointer is cleared once
+// g_fs_mutex is released, since a logout may free it. Used by the socket
+// server's workers.
+task<json> execute_request_async(json req) {
+    PreparedOperation op = prepare_operation(req);
+    if (op.failed || !op.run_async) co_return execute_prepared(op);
+
+    OperationContext ctx;
+    ctx.times = &op.times;
+    if (with_shared_fs_lock(ctx, [&] { return open_context(op, ctx); })) {
+        ctx.session = nullptr;
+        try {
+            co_await op.run_async(ctx);
+        }
+        catch (OFSException& e) {
+            fail_operation(op, e.code, e.what());
+        }
+        catch (std::exception& e) {
+            fail_operation(op, OFS_ERROR_IO_ERROR, e.what());
+        }
+    }
+    co_return finish_operation(op);
+}
+
+// Blocking form of execute_request_async, for the HTTP front end's threads.
+json execute_request(const json& req) {
+    return sync_wait(execute_request_async(req));
+}
+
+// Fields of a binary request, decoded and validated before g_fs_mutex is
+// taken. Which fields are set depends on the opcode.
+struct BinaryRequest {
+    uint8_t opcode = 0;
+    std::string sid;
+    std::string path;       // Username for LOGIN, old path for RENAME
+    std::string data;       // Content, password for LOGIN, new path for RENAME
+    uint32_t index = 0;
+};
+
+// What an opcode produced under the lock, encoded once it is released.
+struct BinaryResult {
+    std::string sid;
+    bool is_admin = false;
+    std::vector<DirEntryInfo> entries;
+    FileMetadata meta = {};
+    FSStats stats = {};
+};
+
+BinaryRequest decode_binary_request(uint8_t opcode, BinaryReader& in) {
+    BinaryRequest req;
+    req.opcode = opcode;
+    if (opcode == BIN_OP_LOGIN) {
+        req.path = in.read_bytes();
+        req.data = in.read_bytes();
+        return req;
+    }
+    req.sid = in.read_bytes();
+    switch (opcode) {
+        case BIN_OP_FILE_CREATE:
+            req.path = normalize_path(in.read_bytes());
+            req.data = in.read_bytes();
+            break;
+        case BIN_OP_FILE_EDIT:
+            req.path = normalize_path(in.read_bytes());
+            req.index = in.read_u32();
+            req.data = in.read_bytes();
+            break;
+        case BIN_OP_RENAME:
+            req.path = normalize_path(in.read_bytes());
+            req.data = normalize_path(in.read_bytes());
+            break;
+        case BIN_OP_FILE_READ: case BIN_OP_FILE_TRUNCATE: case BIN_OP_FILE_DELETE:
+        case BIN_OP_DIR_CREATE: case BIN_OP_DIR_LIST: case BIN_OP_DIR_DELETE: case BIN_OP_STAT:
+            req.path = normalize_path(in.read_bytes());
+            break;
+        default:
+            break;
+    }
+    return req;
+}
+
+// Binary counterpart of run_prepared: the FileSystem calls for one decoded
+// request. FILE_READ pins the file's extent and describes it as a
+// FileSegment, which the event loop sends with sendfile().
+void run_binary_request(const BinaryRequest& req, BinaryResult& result, FileSegment& segment) {
+    if (req.opcode == BIN_OP_LOGIN) {
+        result.sid = login_user(g_FileSystem, req.path, req.data);
+        if (result.sid.empty()) throw OFSException(OFS_ERROR_PERMISSION_DENIED, "Invalid credentials");
+        result.is_admin = (get_session_details(g_FileSystem, result.sid).role == 1);
+        return;
+    }
+
+    ActiveSession* session = find_active_session(g_FileSystem, req.sid);
+    if (session == nullptr) throw OFSException(OFS_ERROR_INVALID_SESSION, "Session expired or invalid");
+    AccessContext caller = session->access;
+
+    switch (req.opcode) {
+        case BIN_OP_LOGOUT:
+            logout_user(g_FileSystem, req.sid);
+            break;
+        case BIN_OP_FILE_CREATE:
+            create_file_with_content(g_FileSystem, req.path, req.data, caller);
+            break;
+        case BIN_OP_FILE_READ: {
+            FileExtent extent = pin_file_extent(g_FileSystem, req.path, caller);
+            segment.fd = extent.fd;
+            segment.offset = extent.offset;
+            segment.length = extent.length;
+            uint32_t start_block = extent.start_block;
+            segment.release = [start_block]() { unpin_file_extent(g_FileSystem, start_block); };
+            break;
+        }
+        case BIN_OP_FILE_EDIT:
+            edit_file(g_FileSystem, req.path, req.data, req.index, caller);
+            break;
+        case BIN_OP_FILE_TRUNCATE:
+            truncate_file_content(g_FileSystem, req.path, caller);
+            break;
+        case BIN_OP_FILE_DELETE:
+            remove_file(g_FileSystem, req.path, caller);
+            break;
+        case BIN_OP_DIR_CREATE:
+            create_directory(g_FileSystem, req.path, caller);
+            break;
+        case BIN_OP_DIR_LIST:
+            result.entries = list_directory_contents(g_FileSystem, req.path, caller);
+            break;
+        case BIN_OP_DIR_DELETE:
+            remove_directory(g_FileSystem, req.path, caller);
+            break;
+        case BIN_OP_RENAME:
+            rename_path(g_FileSystem, req.path, req.data, caller);
+            break;
+        case BIN_OP_STAT:
+            result.meta = get_path_metadata(g_FileSystem, req.path, caller);
+            break;
+        case BIN_OP_FS_STATS:
+            result.stats = get_fs_stats(g_FileSystem);
+            break;
+        default:
+            throw OFSException(OFS_ERROR_INVALID_OPERATION, "Unknown opcode");
+    }
+}
+
+void encode_binary_result(uint8_t opcode, const BinaryResult& result, const FileSegment& segment, BinaryWriter& out) {
+    switch (opcode) {
+        case BIN_OP_LOGIN:
+            out.write_bytes(result.sid);
+            out.write_u8(result.is_admin ? 1 : 0);
+            break;
+        case BIN_OP_FILE_READ:
+            out.write_u32((uint32_t)segment.length);  // The content itself follows via sendfile()
+            break;
+        case BIN_OP_DIR_LIST:
+            out.write_u32((uint32_t)result.entries.size());
+            for (const auto& e : result.entries) {
+                out.write_u8(e.is_directory ? 1 : 0);
+                out.write_bytes(e.name);
+            }
+            break;
+        case BIN_OP_STAT:
+            out.write_bytes(result.meta.name);
+            out.write_u8(result.meta.is_directory ? 1 : 0);
+            out.write_u64(result.meta.size);
+            out.write_u32(result.meta.owner_id);
+            out.write_u32(result.meta.permissions);
+            out.write_u64(result.meta.created_time);
+            out.write_u64(result.meta.modified_time);
+            break;
+        case BIN_OP_FS_STATS:
+            out.write_u64(result.stats.total_size);
+            out.write_u64(result.stats.used_space);
+            out.write_u64(result.stats.free_space);
+            out.write_u32(result.stats.file_count);
+            out.write_u32(result.stats.directory_count);
+            break;
+        default:
+            break;
+    }
+}
+
+// Runs one binary frame (header + body) and returns the encoded response
+// frame. Only run_binary_request holds g_fs_mutex. Used by the socket
+// server's workers; a FILE_READ also fills `segment` with the content to send
+// after the frame.
+std::string execute_binary_request(const std::string& frame, const std::string& remote_addr, FileSegment& segment) {
+    BinaryHeader header;
+    if (frame.size() < BINARY_HEADER_SIZE || !decode_binary_header(frame.data(), header)) {
+        return encode_binary_error(0, OFS_ERROR_INVALID_OPERATION, "Bad frame header");
+    }
+    const char* op = binary_operation_name(header.code);
+    if (op == nullptr) return encode_binary_error(header.request_id, OFS_ERROR_INVALID_OPERATION, "Unknown opcode");
+
+    BinaryReader in(frame.data() + BINARY_HEADER_SIZE, frame.size() - BINARY_HEADER_SIZE);
+    BinaryResult result;
+    StageTimes times;
+    OperationId id = find_operation(op)->id;
+    // Runs on a worker thread, so nothing may escape: an error reply drops
+    // any extent the request pinned for its reply.
+    auto fail = [&](int32_t code, const char* message) {
+        if (segment.release) segment.release();
+        segment = FileSegment();
+        record_stages(id, times);
+        return encode_binary_error(header.request_id, code, message);
+    };
+    try {
+        BinaryRequest req = decode_binary_request(header.code, in);
+        long retry_ms = check_rate_limit(remote_addr, op, req.sid);
+        if (retry_ms > 0) return encode_binary_error(header.request_id, OFS_ERROR_INVALID_OPERATION, "Rate limit exceeded", (uint32_t)retry_ms);
+
+        if (!is_account_operation(op)) {
+            std::shared_lock<std::shared_mutex> lock(g_fs_mutex, std::defer_lock);
+            lock_timed(lock, times);
+            StageClock clock(times, Stage::Execute);
+            run_binary_request(req, result, segment);
+        } else {
+            std::unique_lock<std::shared_mutex> lock(g_fs_mutex, std::defer_lock);
+            lock_timed(lock, times);
+            StageClock clock(times, Stage::Execute);
+            run_binary_request(req, result, segment);
+        }
+
+        std::string reply;
+        {
+            StageClock clock(times, Stage::Serialize);
+            BinaryWriter out;
+            encode_binary_result(header.code, result, segment, out);
+            reply = out.finish(BIN_STATUS_OK, header.request_id, segment.length);
+        }
+        record_stages(id, times);
+        return reply;
+    }
+    catch (OFSException& e) {
+        return fail(e.code, e.what());
+    }
+    catch (BinaryDecodeError& e) {
+        return fail(OFS_ERROR_INVALID_OPERATION, e.what());
+    }
+    catch (std::exception& e) {
+        return fail(OFS_ERROR_IO_ERROR, e.what());
+    }
+    catch (...) {
+        return fail(OFS_ERROR_IO_ERROR, "Internal error");
+    }
+}
+
+// Streaming transfers move file content through this many bytes at a time.
+const size_t TRANSFER_CHUNK_SIZE = 64 * 1024;
+
+void send_json(httplib::Response& res, int status, const json& body) {
+    res.status = status;
+    res.set_content(response_text(body), "application/json");
+}
+
+// Shared front half of the streaming endpoints: rate limit and session lookup.
+// Returns false after writing the error response.
+bool authorize_transfer(const httplib::Request& req, httplib::Response& res, const std::string& op, AccessContext& caller) {
+    std::string sid = req.get_param_value("session_id");
+    long retry_ms = check_rate_limit(req.remote_addr, op, sid);
+    if (retry_ms > 0) {
+        res.set_header("Retry-After", std::to_string((retry_ms + 999) / 1000));
+        send_json(res, 429, {{"status", "error"}, {"error_message", "Rate limit exceeded"}, {"retry_after_ms", retry_ms}});
+        return false;
+    }
+    ActiveSession* session = find_active_session(g_FileSystem, sid);
+    if (session == nullptr) {
+        send_json(res, 401, {{"status", "error"}, {"error_message", "Session expired or invalid"}});
+        return false;
+    }
+    caller = session->access;
+    return true;
+}
+
+// Digits only: std::stoull alone would accept "12abc", a sign or spaces.
+uint64_t parse_content_length(const std::string& text) {
+    bool digits = !text.empty() && text.find_first_not_of("0123456789") == std::string::npos;
+    try {
+        if (digits) return std::stoull(text);
+    }
+    catch (std::out_of_range&) {}
+    throw OFSException(OFS_ERROR_INVALID_OPERATION, "Invalid Content-Length");
+}
+
+// POST /api/upload?session_id=...&path=...  Body: raw file content.
+// The body is never buffered whole: each piece httplib reads is written to the
+// file's extent as it arrives. g_fs_mutex is held only around reserve and
+// publish, not while the client is sending.
+void handle_upload(const httplib::Request& req, httplib::Response& res, const httplib::ContentReader& content_reader) {
+    if (!req.has_header("Content-Length")) {
+        send_json(res, 411, {{"status", "error"}, {"error_message", "Content-Length required"}});
+        return;
+    }
+    uint64_t size = 0;
+    std::string path = req.get_param_value("path");
+    FileUpload upload;
+    try {
+        size = parse_content_length(req.get_header_value("Content-Length"));
+        path = normalize_path(path);
+        std::shared_lock<std::shared_mutex> lock(g_fs_mutex);
+        AccessContext caller;
+        if (!authorize_transfer(req, res, "create_file_with_content", caller)) return;
+        begin_file_upload(g_FileSystem, path, size, upload, caller);
+    }
+    catch (OFSException& e) {
+        send_json(res, 400, {{"status", "error"}, {"error_code", e.code}, {"error_message", e.what()}});
+        return;
+    }
+    catch (std::exception& e) {
+        send_json(res, 400, {{"status", "error"}, {"error_message", e.what()}});
+        return;
+    }
+
+    bool received = content_reader([&](const char* data, size_t length) {
+        return write_file_upload(g_FileSystem, upload, data, length);
+    });
+
+    try {
+        std::shared_lock<std::shared_mutex> lock(g_fs_mutex);
+        if (!received) {
+            abort_file_upload(g_FileSystem, upload);
+            send_json(res, 400, {{"status", "error"}, {"error_message", "Upload interrupted"}});
+            return;
+        }
+        finish_file_upload(g_FileSystem, upload);
+    }
+    catch (OFSException& e) {
+        send_json(res, 400, {{"status", "error"}, {"error_code", e.code}, {"error_message", e.what()}});
+        return;
+    }
+    send_json(res, 200, {{"status", "success"}, {"operation", "file_upload"}, {"data", {{"path", path}, {"size", size}}}});
+}
+
+// GET /api/download?session_id=...&path=...  Streams the raw content with a
+// fixed Content-Length, one TRANSFER_CHUNK_SIZE read per provider call.
+void handle_download(const httplib::Request& req, httplib::Response& res) {
+    auto download = std::make_shared<FileDownload>();
+    try {
+        std::string path = normalize_path(req.get_param_value("path"));
+        std::shared_lock<std::shared_mutex> lock(g_fs_mutex);
+        AccessContext caller;
+        if (!authorize_transfer(req, res, "file_read", caller)) return;
+        begin_file_download(g_FileSystem, path, *download, caller);
+    }
+    catch (OFSException& e) {
+        send_json(res, e.code == OFS_ERROR_NOT_FOUND ? 404 : 400, {{"status", "error"}, {"error_code", e.code}, {"error_message", e.what()}});
+        return;
+    }
+
+    auto buffer = std::make_shared<std::vector<char>>(TRANSFER_CHUNK_SIZE);
+    res.set_content_provider(download->entry.total_size, "application/octet-stream",
+        [download, buffer](size_t offset, size_t length, httplib::DataSink& sink) {
+            size_t bytes_read;
+            {
+                std::shared_lock<std::shared_mutex> lock(g_fs_mutex);
+                bytes_read = read_file_download(g_FileSystem, *download, offset, buffer->data(), std::min(length, buffer->size()));
+            }
+            // The file changed underneath us; abort rather than send mixed content.
+            if (bytes_read == 0) return false;
+            return sink.write(buffer->data(), bytes_read);
+        });
+}
+
+const size_t MAX_BATCH_OPERATIONS = 256;
+
+// Runs a list of operations in order under one exclusive acquisition of
+// g_fs_mutex, with their metadata writes coalesced into a single flush.
+// Operations without their own session_id use the batch's. Rate limits are
+// still charged per operation, before the lock is taken.
+json execute_batch(const json& batch, const std::string& remote_addr) {
+    if (!batch.contains("operations") || !batch["operations"].is_array()) {
+        return {{"status", "error"}, {"error_message", "Batch requires an 'operations' array"}};
+    }
+    const json& operations = batch["operations"];
+    if (operations.size() > MAX_BATCH_OPERATIONS) {
+        return {{"status", "error"}, {"error_message", "Batch exceeds " + std::to_string(MAX_BATCH_OPERATIONS) + " operations"}};
+    }
+    bool stop_on_error = batch.value("stop_on_error", false);
+    std::string batch_sid = session_id_of(batch);
+
+    // Everything is decoded and charged before the lock and rendered after it.
+    std::vector<PreparedOperation> prepared;
+    std::vector<long> retry_after;
+    for (const auto& operation : operations) {
+        json request = operation.is_object() ? operation : json::object();
+        if (session_id_of(request).empty()) request["session_id"] = batch_sid;
+        long retry_ms = check_rate_limit(remote_addr, request);
+        PreparedOperation op = prepare_operation(request);
+        if (retry_ms > 0) {
+            op.failed = true;
+            op.response = {{"status", "error"}, {"error_message", "Rate limit exceeded"}, {"retry_after_ms", retry_ms}};
+        } else if (op.info != nullptr && op.info->id == OperationId::FsShutdown) {
+            op.failed = true;
+            op.response = {{"status", "error"}, {"error_message", "fs_shutdown cannot run inside a batch"}};
+        }
+        prepared.push_back(std::move(op));
+        if (retry_ms > 0 && stop_on_error) break;
+    }
+
+    size_t completed = 0;
+    bool stopped = false;
+    {
+        std::unique_lock<std::shared_mutex> lock(g_fs_mutex);
+        begin_metadata_batch(g_FileSystem);
+        for (PreparedOperation& op : prepared) {
+            run_prepared(op);
+            ++completed;
+            if (stop_on_error && op.failed) {
+                stopped = prepared.size() > completed || operations.size() > prepared.size();
+                break;
+            }
+        }
+        end_metadata_batch(g_FileSystem);
+    }
+
+    json results = json::array();
+    for (size_t i = 0; i < completed; ++i) results.push_back(finish_operation(prepared[i]));
+
+    json resp;
+    resp["status"] = "success";
+    resp["data"]["results"] = results;
+    resp["data"]["stopped"] = stopped;
     return resp;
 }
 
-int main() {
-    const std::string OMNI_FILE = "my_ofs.omni";
+// Usage: ofs_server [config.uconf]   (default: compiled/default.uconf)
+int main(int argc, char* argv[]) {
+    const std::string config_path = argc > 1 ? argv[1] : "compiled/default.uconf";
+    OFSConfig config;
+    std::string config_error;
+    if (!load_config(config_path, config, config_error)) {
+        std::cerr << "FATAL: " << config_error << std::endl;
+        return 1;
+    }
+    std::string log_error;
+    if (!log_start(config.log, log_error)) {
+        std::cerr << "FATAL: " << log_error << std::endl;
+        return 1;
+    }
+    if (!config.log.file.empty()) std::cout << "Logging to " << config.log.file << std::endl;
+
+    const std::string& OMNI_FILE = config.filesystem.container;
     std::ifstream f(OMNI_FILE);
     if (!f.good()) {
-        format_filesystem(OMNI_FILE);
+        format_filesystem(OMNI_FILE, config);
+    }
+    try {
+        init_filesystem(g_FileSystem, OMNI_FILE, config);
+    }
+    catch (OFSException& e) {
+        log_stop();
+        std::cerr << "FATAL: " << e.what() << std::endl;
+        return 1;
     }
-    init_filesystem(g_FileSystem, OMNI_FILE);
 
     httplib::Server svr;
     svr.set_mount_point("/", "./www");
+    g_server = &svr;
+    std::signal(SIGTERM, handle_stop_signal);
+    std::signal(SIGINT, handle_stop_signal);
 
     svr.Post("/api", [](const httplib::Request& req, httplib::Response& res) {
         try {
             auto json_req = json::parse(req.body);
-            std::lock_guard<std::mutex> lock(g_fs_mutex);
-            
-            json json_resp = handle_ofs_logic(json_req);
-            res.set_content(json_resp.dump(), "application/json");
-
-            // Handle shutdown request from within the main thread loop logic context
-            if (json_resp["operation"] == "fs_shutdown" && json_resp["status"] == "success") {
-                std::thread([](){ 
-                    std::this_thread::sleep_for(std::chrono::seconds(1)); 
-                    exit(0); 
-                }).detach();
+            long retry_ms = check_rate_limit(req.remote_addr, json_req);
+            if (retry_ms > 0) {
+                json err = {{"status", "error"}, {"error_message", "Rate limit exceeded"}, {"retry_after_ms", retry_ms}};
+                res.status = 429;
+                res.set_header("Retry-After", std::to_string((retry_ms + 999) / 1000));
+                res.set_content(response_text(err), "application/json");
+                return;
             }
+            json json_resp = execute_request(json_req);
+            res.set_content(response_text(json_resp), "application/json");
         } 
         catch (std::exception& e) {
             json err = {{"status", "error"}, {"error_message", e.what()}};
-            res.set_content(err.dump(), "application/json");
+            res.set_content(response_text(err), "application/json");
         }
     });
 
-    std::cout << "OFS Server running at http://localhost:8080" << std::endl;
-    svr.listen("0.0.0.0", 8080);
-    
+    // Body: {"session_id", "stop_on_error", "operations": [{operation, parameters}, ...]}
+    svr.Post("/api/batch", [](const httplib::Request& req, httplib::Response& res) {
+        try {
+            json json_resp = execute_batch(json::parse(req.body), req.remote_addr);
+            res.set_content(response_text(json_resp), "application/json");
+        }
+        catch (std::exception& e) {
+            json err = {{"status", "error"}, {"error_message", e.what()}};
+            res.set_content(response_text(err), "application/json");
+        }
+    });
+
+    // Prometheus scrape target: latency summaries per operation and stage,
+    // plus the socket server's counters and gauges.
+    svr.Get("/metrics", [](const httplib::Request&, httplib::Response& res) {
+        res.set_content(render_metrics(), "text/plain; version=0.0.4");
+    });
+
+    svr.Post("/api/upload", handle_upload);
+    svr.Get("/api/download", handle_download);
+
+    std::thread(start_server, config.server).detach();
+
+    std::cout << "OFS Server running at http://localhost:" << config.http_port << std::endl;
+    svr.listen("0.0.0.0", config.http_port);
+
+    // listen() returns once the HTTP handlers have finished; give the socket
+    // server's queued requests the same chance before taking the filesystem.
+    if (!stop_server(std::chrono::seconds(config.server.drain_timeout_seconds))) {
+        LOG_WARN("Drain timeout reached with requests still running");
+    }
+    std::unique_lock<std::shared_mutex> lock(g_fs_mutex);
+    shutdown_filesystem(g_FileSystem);
     user_map_destroy(g_FileSystem.user_map);
-    return 0;
+    // Worker and I/O threads are detached and may still be parked on the
+    // queue or on g_fs_mutex; leave without running static destructors under
+    // them.
+    log_stop();
+    std::cout.flush();
+    std::cerr.flush();
+    std::_Exit(0);
 }
\ No newline at end of file
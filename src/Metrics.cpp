@@ -0,0 +1,186 @@
+#include "../include/Metrics.h"
+#include "../include/Server.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+// ============================================================================
+// LOG-LINEAR BUCKETS
+// ============================================================================
+// Values below 16 ns get a bucket each. Above that, each power of two
+// [2^m, 2^(m+1)) is split into 8 equal buckets, indexed by the three bits
+// after the leading one. Values from 2^40 ns up share the last bucket.
+
+static const unsigned SUB_BUCKET_BITS = 3;
+static const unsigned LINEAR_LIMIT = 2u << SUB_BUCKET_BITS;   // 16
+static const unsigned MAX_MAGNITUDE = 40;
+static const size_t BUCKET_COUNT = LINEAR_LIMIT + (MAX_MAGNITUDE - (SUB_BUCKET_BITS + 1)) * (1u << SUB_BUCKET_BITS);
+
+static const size_t OP_COUNT = (size_t)OperationId::Count;
+static const size_t STAGE_COUNT = (size_t)Stage::Count;
+
+static const char* const STAGE_NAMES[STAGE_COUNT] = {"queue_wait", "lock_wait", "execute", "io", "serialize"};
+
+static size_t bucket_index(uint64_t value) {
+    if (value < LINEAR_LIMIT) return (size_t)value;
+    if (value >> MAX_MAGNITUDE) return BUCKET_COUNT - 1;
+    unsigned magnitude = 63 - __builtin_clzll(value);
+    unsigned shift = magnitude - SUB_BUCKET_BITS;
+    return LINEAR_LIMIT + (magnitude - (SUB_BUCKET_BITS + 1)) * (1u << SUB_BUCKET_BITS)
+         + (size_t)((value >> shift) - (1u << SUB_BUCKET_BITS));
+}
+
+// Largest value that lands in the bucket, which is what a quantile reports.
+static uint64_t bucket_upper_bound(size_t index) {
+    if (index < LINEAR_LIMIT) return index;
+    size_t offset = index - LINEAR_LIMIT;
+    unsigned magnitude = (unsigned)(offset >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS + 1;
+    uint64_t sub = (offset & ((1u << SUB_BUCKET_BITS) - 1)) + (1u << SUB_BUCKET_BITS);
+    return ((sub + 1) << (magnitude - SUB_BUCKET_BITS)) - 1;
+}
+
+// ============================================================================
+// PER-THREAD SHARDS
+// ============================================================================
+// Only the owning thread writes a shard, so an increment is a plain load and
+// store; the atomics are there so a scrape on another thread reads whole
+// values. Histograms are allocated on a thread's first sample for that
+// (operation, stage). Shards outlive their threads so no samples are lost;
+// the server's threads are long-lived pools, so few are ever created.
+
+struct Histogram {
+    std::atomic<uint64_t> counts[BUCKET_COUNT];
+    std::atomic<uint64_t> sum_ns;
+};
+
+struct MetricShard {
+    std::atomic<Histogram*> histograms[OP_COUNT][STAGE_COUNT];
+    std::atomic<uint64_t> completed[OP_COUNT];
+};
+
+static std::mutex g_shards_mutex;
+static std::vector<MetricShard*> g_shards;
+static thread_local MetricShard* t_shard = nullptr;
+
+static MetricShard& local_shard() {
+    if (t_shard == nullptr) {
+        t_shard = new MetricShard();
+        std::lock_guard<std::mutex> lock(g_shards_mutex);
+        g_shards.push_back(t_shard);
+    }
+    return *t_shard;
+}
+
+static void bump(std::atomic<uint64_t>& counter, uint64_t amount) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+void record_latency(OperationId op, Stage stage, uint64_t nanoseconds) {
+    if ((size_t)op >= OP_COUNT || (size_t)stage >= STAGE_COUNT) return;
+    std::atomic<Histogram*>& slot = local_shard().histograms[(size_t)op][(size_t)stage];
+    Histogram* histogram = slot.load(std::memory_order_relaxed);
+    if (histogram == nullptr) {
+        histogram = new Histogram();
+        slot.store(histogram, std::memory_order_release);
+    }
+    bump(histogram->counts[bucket_index(nanoseconds)], 1);
+    bump(histogram->sum_ns, nanoseconds);
+}
+
+void record_stages(OperationId op, const StageTimes& times) {
+    if ((size_t)op >= OP_COUNT) return;
+    for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+        if (times.seen & (1u << stage)) record_latency(op, (Stage)stage, times.ns[stage]);
+    }
+    bump(local_shard().completed[(size_t)op], 1);
+}
+
+// ============================================================================
+// PROMETHEUS EXPOSITION
+// ============================================================================
+
+static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+static void append_value(std::string& out, double value) {
+    char text[32];
+    snprintf(text, sizeof(text), " %.9g\n", value);
+    out += text;
+}
+
+static void append_metric(std::string& out, const char* name, const char* type, const char* help, double value) {
+    out += "# HELP "; out += name; out += ' '; out += help; out += '\n';
+    out += "# TYPE "; out += name; out += ' '; out += type; out += '\n';
+    out += name;
+    append_value(out, value);
+}
+
+std::string render_metrics() {
+    std::vector<MetricShard*> shards;
+    {
+        std::lock_guard<std::mutex> lock(g_shards_mutex);
+        shards = g_shards;
+    }
+
+    std::string out;
+    out += "# HELP ofs_operation_duration_seconds Time each operation spent in each stage.\n";
+    out += "# TYPE ofs_operation_duration_seconds summary\n";
+    std::vector<uint64_t> merged(BUCKET_COUNT);
+    for (size_t op = 0; op < OP_COUNT; ++op) {
+        for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+            std::fill(merged.begin(), merged.end(), 0);
+            uint64_t total = 0, sum_ns = 0;
+            for (MetricShard* shard : shards) {
+                Histogram* histogram = shard->histograms[op][stage].load(std::memory_order_acquire);
+                if (histogram == nullptr) continue;
+                for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+                    uint64_t count = histogram->counts[i].load(std::memory_order_relaxed);
+                    merged[i] += count;
+                    total += count;
+                }
+                sum_ns += histogram->sum_ns.load(std::memory_order_relaxed);
+            }
+            if (total == 0) continue;
+
+            std::string labels = "{operation=\"" + std::string(OPERATIONS[op].name) + "\",stage=\"" + STAGE_NAMES[stage] + "\"";
+            size_t bucket = 0;
+            uint64_t seen = merged[0];
+            for (double quantile : QUANTILES) {
+                uint64_t rank = (uint64_t)std::ceil(quantile * total);
+                if (rank == 0) rank = 1;
+                while (seen < rank && bucket + 1 < BUCKET_COUNT) seen += merged[++bucket];
+                char q[16];
+                snprintf(q, sizeof(q), "%g", quantile);
+                out += "ofs_operation_duration_seconds" + labels + ",quantile=\"" + q + "\"}";
+                append_value(out, bucket_upper_bound(bucket) / 1e9);
+            }
+            out += "ofs_operation_duration_seconds_sum" + labels + "}";
+            append_value(out, sum_ns / 1e9);
+            out += "ofs_operation_duration_seconds_count" + labels + "}";
+            append_value(out, (double)total);
+        }
+    }
+
+    out += "# HELP ofs_operations_total Requests completed, per operation.\n";
+    out += "# TYPE ofs_operations_total counter\n";
+    for (size_t op = 0; op < OP_COUNT; ++op) {
+        uint64_t completed = 0;
+        for (MetricShard* shard : shards) completed += shard->completed[op].load(std::memory_order_relaxed);
+        out += "ofs_operations_total{operation=\"" + std::string(OPERATIONS[op].name) + "\"}";
+        append_value(out, (double)completed);
+    }
+
+    const ServerMetrics& m = g_server_metrics;
+    append_metric(out, "ofs_connections_accepted_total", "counter", "Socket connections accepted.", m.accepted.load());
+    append_metric(out, "ofs_connections_rejected_total", "counter", "Connections refused over max_connections.", m.rejected_connections.load());
+    append_metric(out, "ofs_requests_processed_total", "counter", "Socket requests executed.", m.processed.load());
+    append_metric(out, "ofs_requests_rejected_total", "counter", "Socket requests refused because the queue was full.", m.rejected_queue_full.load());
+    append_metric(out, "ofs_requests_timed_out_total", "counter", "Socket requests dropped after queue_timeout.", m.timed_out.load());
+    append_metric(out, "ofs_connections_active", "gauge", "Open socket connections.", m.active_connections.load());
+    append_metric(out, "ofs_queue_depth", "gauge", "Socket requests waiting for a worker.", m.queue_depth.load());
+    append_metric(out, "ofs_requests_in_flight", "gauge", "Socket requests queued or running.", m.in_flight.load());
+    return out;
+}
@@ -0,0 +1,41 @@
+#include "../include/OperationParams.h"
+#include "../include/FileSystem.h"
+
+using json = nlohmann::json;
+
+std::string session_id_of(const json& req) {
+    auto sid = req.find("session_id");
+    return (sid != req.end() && sid->is_string()) ? sid->get<std::string>() : "";
+}
+
+const json& parameters_of(const json& req) {
+    static const json NO_PARAMETERS = json::object();
+    auto params = req.find("parameters");
+    return (params != req.end() && params->is_object()) ? *params : NO_PARAMETERS;
+}
+
+const json& required_param(const json& params, const char* key) {
+    auto it = params.find(key);
+    if (it == params.end()) throw OFSException(OFS_ERROR_INVALID_OPERATION, std::string("Missing parameter '") + key + "'");
+    return *it;
+}
+
+std::string string_param(const json& params, const char* key) {
+    const json& value = required_param(params, key);
+    if (!value.is_string()) throw OFSException(OFS_ERROR_INVALID_OPERATION, std::string("Parameter '") + key + "' must be a string");
+    return value.get<std::string>();
+}
+
+std::string path_param(const json& params, const char* key) {
+    return normalize_path(string_param(params, key));
+}
+
+UserBatchParams UserBatchParams::decode(const json& p) {
+    const json& list = required_param(p, "users");
+    if (!list.is_array()) throw OFSException(OFS_ERROR_INVALID_OPERATION, "Parameter 'users' must be an array");
+    UserBatchParams params;
+    for (const auto& u : list) {
+        params.users.push_back({u.value("username", ""), u.value("password", ""), u.value("role", 0u)});
+    }
+    return params;
+}
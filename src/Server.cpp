@@ -1,107 +1,787 @@
-#include <iostream>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <vector>
+#include <unordered_map>
+#include <deque>
+#include <chrono>
+#include <algorithm>
 #include "../include/RequestQueue.h"
+#include "../include/Server.h"
+#include "../include/BinaryProtocol.h"
+#include "../include/OFSTypes.h"
+#include "../include/OperationTable.h"
+#include "../include/Metrics.h"
+#include "../include/Log.h"
 
-// This is the global queue defined in Main.cpp
-extern RequestQueue g_request_queue;
+using json = nlohmann::json;
+
+ServerMetrics g_server_metrics;
+
+// How a connection frames its requests. JSON connections are told apart by
+// their first byte; connections on the binary port are Binary from the start.
+enum class WireMode {
+    Unknown,
+    Legacy,   // One bare JSON request, one reply, then close
+    Framed,   // 4-byte big-endian length + JSON, connection stays open
+    Binary    // BinaryProtocol.h frames, connection stays open
+};
+
+// One piece of pending output: bytes, then optionally a range of the
+// container file that is sent with sendfile() instead of being copied.
+struct OutputChunk {
+    std::string bytes;
+    FileSegment file;
+};
+
+/**
+ * @brief A client connection owned by one event loop.
+ *
+ * Only the owning loop thread touches it. Workers refer to it by
+ * (fd, id) and hand replies back through EventLoop::post().
+ */
+struct Connection {
+    int fd;
+    uint64_t id;
+    std::string remote_addr;
+    WireMode mode = WireMode::Unknown;
+    std::string input;
+    std::deque<OutputChunk> output;
+    size_t output_offset = 0;        // Into output.front().bytes
+    bool request_pending = false;    // Handed to a worker, reply not back yet
+    bool read_paused = false;        // Input buffer full, waiting for a dispatch
+    bool peer_closed = false;        // Client shut down its write side
+    bool close_after_write = false;
+};
+
+static const size_t FRAME_HEADER_SIZE = 4;
+
+// A finished reply travelling from a worker back to the owning loop.
+struct Completion {
+    int fd;
+    uint64_t connection_id;
+    std::string data;
+    FileSegment segment;
+};
+
+/**
+ * @brief Finds the end of the first complete JSON request in the buffer.
+ *
+ * Tracks brace/bracket depth while skipping over string literals, so a
+ * request split across several reads is only dispatched once it is whole.
+ * Input that does not start with an object or array is passed through as
+ * is and left for the JSON parser to reject.
+ *
+ * @return The length of the request, or 0 if more bytes are needed.
+ */
+static size_t find_request_end(const std::string& buffer) {
+    size_t i = 0;
+    while (i < buffer.size() && isspace((unsigned char)buffer[i])) { ++i; }
+    if (i == buffer.size()) return 0;
+    if (buffer[i] != '{' && buffer[i] != '[') return buffer.size();
+
+    int depth = 0;
+    bool in_string = false;
+    bool escaped = false;
+    for (; i < buffer.size(); ++i) {
+        char c = buffer[i];
+        if (in_string) {
+            if (escaped) { escaped = false; }
+            else if (c == '\\') { escaped = true; }
+            else if (c == '"') { in_string = false; }
+            continue;
+        }
+        if (c == '"') { in_string = true; }
+        else if (c == '{' || c == '[') { ++depth; }
+        else if (c == '}' || c == ']') {
+            if (--depth == 0) return i + 1;
+        }
+    }
+    return 0;
+}
+
+// Request bytes that count as one unit of scheduling cost, and the least a
+// content operation costs, since a read's reply size is not known up front.
+static const uint32_t COST_BYTES_PER_UNIT = 4096;
+static const uint32_t BULK_BASE_COST = 4;
 
 /**
- * @brief Handles an individual client connection in its own thread.
+ * @brief Reads the string value of a top-level `"key"` without parsing the request.
  *
- * This function's job is to read a single message from a client,
- * package it into a ClientRequest object, and push it onto the global
- * work queue. It then detaches, letting the worker thread handle the rest.
+ * Keys nested inside "parameters" are skipped, and when a key repeats the
+ * last one wins, as it does in the parser the worker runs. A value the scan
+ * cannot read (escapes, not a string) comes back empty.
+ */
+static std::string peek_top_level_string(const std::string& text, const char* key) {
+    const size_t key_length = strlen(key);
+    std::string found;
+    int depth = 0;
+    bool expect_key = false;
+    for (size_t i = 0; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '"') {
+            size_t end = i + 1;
+            while (end < text.size() && text[end] != '"') { end += (text[end] == '\\') ? 2 : 1; }
+            if (end >= text.size()) return found;
+            if (depth != 1 || !expect_key) { i = end; continue; }
+
+            bool match = end - i - 1 == key_length && text.compare(i + 1, key_length, key) == 0;
+            size_t pos = end + 1;
+            while (pos < text.size() && isspace((unsigned char)text[pos])) { ++pos; }
+            if (pos < text.size() && text[pos] == ':') { ++pos; }
+            while (pos < text.size() && isspace((unsigned char)text[pos])) { ++pos; }
+            if (match) {
+                found.clear();
+                if (pos < text.size() && text[pos] == '"') {
+                    size_t close = text.find_first_of("\"\\", pos + 1);
+                    if (close != std::string::npos && text[close] == '"') found = text.substr(pos + 1, close - pos - 1);
+                }
+            }
+            expect_key = false;
+            i = pos - 1;  // The value is scanned like any other token
+            continue;
+        }
+        if (c == '{' || c == '[') {
+            ++depth;
+            expect_key = (c == '{' && depth == 1);
+        } else if (c == '}' || c == ']') {
+            --depth;
+        } else if (c == ',' && depth == 1) {
+            expect_key = true;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Sets the request's scheduling class, cost and tenant.
+ *
+ * The class comes from the operation's flags and the cost from the payload
+ * size. A request whose operation cannot be read is scheduled as bulk, so
+ * disguising a name never buys a better class. The tenant is the client
+ * address: a session id is unverified until a worker looks it up, and a
+ * made-up one per request would otherwise open a fresh flow each time.
+ */
+static void classify_request(ClientRequest& req) {
+    std::string op;
+    if (req.binary) {
+        BinaryHeader header;
+        decode_binary_header(req.request_data.data(), header);
+        const char* name = binary_operation_name(header.code);
+        if (name != nullptr) op = name;
+    } else {
+        op = peek_top_level_string(req.request_data, "operation");
+    }
+
+    const OperationInfo* info = find_operation(op);
+    uint8_t flags = info != nullptr ? info->flags : OP_BULK;
+    req.operation = info != nullptr ? info->id : OperationId::Count;
+    req.priority = (flags & OP_BULK) ? RequestClass::Bulk
+                 : (flags & OP_ADMIN) ? RequestClass::Admin
+                 : RequestClass::Interactive;
+    req.cost = 1 + (uint32_t)(req.request_data.size() / COST_BYTES_PER_UNIT);
+    if (flags & OP_BULK) req.cost = std::max(req.cost, BULK_BASE_COST);
+    req.tenant = req.remote_addr;
+}
+
+static std::string error_text(const std::string& message) {
+    json err = {{"status", "error"}, {"error_message", message}};
+    return response_text(err);
+}
+
+static uint32_t read_frame_length(const std::string& buffer) {
+    const unsigned char* p = (const unsigned char*)buffer.data();
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void append_output(Connection& conn, const std::string& data) {
+    if (conn.output.empty() || conn.output.back().file.length > 0) conn.output.emplace_back();
+    conn.output.back().bytes += data;
+}
+
+static void append_frame(Connection& conn, const std::string& payload) {
+    uint32_t length = (uint32_t)payload.size();
+    char header[FRAME_HEADER_SIZE] = {(char)(length >> 24), (char)(length >> 16), (char)(length >> 8), (char)length};
+    append_output(conn, std::string(header, FRAME_HEADER_SIZE));
+    append_output(conn, payload);
+}
+
+static void release_segment(FileSegment& segment) {
+    if (segment.release) segment.release();
+    segment.release = nullptr;
+    segment.length = 0;
+}
+
+/**
+ * @brief One edge-triggered epoll reactor.
  *
- * @param client_socket The file descriptor for the connected client socket.
+ * Each loop has its own SO_REUSEPORT listener, so the kernel spreads new
+ * connections across loops without a shared accept lock. All socket I/O is
+ * non-blocking; complete requests go to the shared RequestQueue and replies
+ * come back through an eventfd-signalled completion list.
  */
-void client_handler(int client_socket) {
-    std::cout << "Handling new client on socket fd: " << client_socket << std::endl;
+class EventLoop {
+public:
+    EventLoop(int id, int listen_fd, int binary_listen_fd, RequestQueue& queue, const ServerConfig& config)
+        : m_id(id), m_listen_fd(listen_fd), m_binary_listen_fd(binary_listen_fd), m_queue(queue), m_config(config) {
+        m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        m_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLET;
+        for (int fd : {m_listen_fd, m_binary_listen_fd, m_wake_fd}) {
+            if (fd < 0) continue;
+            ev.data.fd = fd;
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+
+    void run();
+    void post(Completion&& completion);
+    void wake();
+
+private:
+    void accept_connections(int listen_fd, WireMode mode);
+    // These return false once the connection has been closed and erased.
+    bool handle_readable(Connection& conn);
+    bool dispatch(Connection& conn);
+    bool respond(Connection& conn, const std::string& data, bool close_after, FileSegment&& segment = FileSegment());
+    bool respond_error(Connection& conn, const std::string& message, uint32_t request_id = 0);
+    bool close_if_idle(Connection& conn);
+    bool flush(Connection& conn);
+    void close_connection(Connection& conn);
+    void drain_completions();
+    void close_listeners();
+
+    int m_id;
+    int m_listen_fd;
+    int m_binary_listen_fd;  // -1 when the binary protocol is off
+    int m_epoll_fd;
+    int m_wake_fd;
+    RequestQueue& m_queue;
+    const ServerConfig& m_config;
+    uint64_t m_next_connection_id = 1;
+    std::unordered_map<int, Connection> m_connections;
+
+    std::mutex m_completion_mutex;
+    std::vector<Completion> m_completions;
+};
+
+// Filled by start_server() before any loop or worker thread exists and never
+// changed afterwards. stop_server() may run while it is still being filled,
+// so it reads the vector only after start_server() has set g_start_finished.
+static std::vector<EventLoop*> g_event_loops;
+static std::mutex g_start_mutex;
+static std::condition_variable g_start_done;
+static bool g_start_finished = false;   // Guarded by g_start_mutex
+// Set by stop_server(); loops then close their listeners and refuse new requests.
+static std::atomic<bool> g_draining{false};
 
-    // Create a buffer to hold incoming data.
-    std::vector<char> buffer(2048);
+void EventLoop::run() {
+    std::vector<epoll_event> events(256);
+    while (true) {
+        int count = epoll_wait(m_epoll_fd, events.data(), (int)events.size(), -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("epoll_wait failed; event loop stopped").kv("loop", m_id).kv("errno", errno);
+            return;
+        }
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == m_listen_fd) { accept_connections(fd, WireMode::Unknown); continue; }
+            if (fd == m_binary_listen_fd) { accept_connections(fd, WireMode::Binary); continue; }
+            if (fd == m_wake_fd) {
+                drain_completions();
+                if (g_draining) close_listeners();
+                continue;
+            }
 
-    // Read data from the client socket.
-    ssize_t bytes_read = recv(client_socket, buffer.data(), buffer.size() - 1, 0);
+            auto it = m_connections.find(fd);
+            if (it == m_connections.end()) continue;
+            Connection& conn = it->second;
+            if (events[i].events & EPOLLERR) { close_connection(conn); continue; }
+            if ((events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) && !handle_readable(conn)) continue;
+            if (events[i].events & EPOLLOUT) { flush(conn); }
+        }
+    }
+}
 
-    if (bytes_read > 0) {
-        // Null-terminate the received data to treat it as a C-string.
-        buffer[bytes_read] = '\0';
+/**
+ * @brief Accepts until the backlog is empty (required with EPOLLET).
+ */
+void EventLoop::accept_connections(int listen_fd, WireMode mode) {
+    while (true) {
+        sockaddr_in client_addr{};
+        socklen_t addr_len = sizeof(client_addr);
+        int client_socket = accept4(listen_fd, (struct sockaddr*)&client_addr, &addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_socket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_WARN("accept failed").kv("errno", errno);
+            }
+            return;
+        }
+        g_server_metrics.accepted++;
 
-        // Create a request struct.
-        ClientRequest req;
-        req.client_socket = client_socket;
-        req.request_data = buffer.data();
+        // Reserve the slot before checking it: the loops accept concurrently,
+        // so a separate load and increment could let several past the limit.
+        if (g_server_metrics.active_connections.fetch_add(1) >= (uint64_t)m_config.max_connections) {
+            g_server_metrics.active_connections--;
+            g_server_metrics.rejected_connections++;
+            std::string text = (mode == WireMode::Binary)
+                ? encode_binary_error(0, OFS_ERROR_INVALID_OPERATION, "Too many connections")
+                : error_text("Too many connections");
+            send(client_socket, text.data(), text.size(), MSG_NOSIGNAL);
+            close(client_socket);
+            continue;
+        }
 
-        // Push the request onto the thread-safe queue.
-        g_request_queue.push(req);
+        char addr_text[INET_ADDRSTRLEN] = {};
+        inet_ntop(AF_INET, &client_addr.sin_addr, addr_text, sizeof(addr_text));
 
-        std::cout << "Request from socket " << client_socket << " has been queued for processing." << std::endl;
+        Connection& conn = m_connections[client_socket];
+        conn = Connection();
+        conn.fd = client_socket;
+        conn.id = m_next_connection_id++;
+        conn.remote_addr = addr_text;
+        conn.mode = mode;
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = client_socket;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, client_socket, &ev);
+    }
+}
+
+/**
+ * @brief Reads everything available, then dispatches a complete request.
+ */
+bool EventLoop::handle_readable(Connection& conn) {
+    char buffer[16384];
+    conn.read_paused = false;
+    while (true) {
+        // Backpressure: with one request buffered in full, stop reading until
+        // it is dispatched. Pipelined requests wait in the socket instead.
+        if (conn.input.size() > m_config.max_request_bytes + FRAME_HEADER_SIZE) {
+            conn.read_paused = true;
+            break;
+        }
+        ssize_t bytes_read = recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (bytes_read > 0) {
+            conn.input.append(buffer, bytes_read);
+            continue;
+        }
+        if (bytes_read == 0) {
+            conn.peer_closed = true;
+            break;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        close_connection(conn);
+        return false;
+    }
+
+    if (!dispatch(conn)) return false;
+    return close_if_idle(conn);
+}
+
+/**
+ * @brief Moves the next complete request from the input buffer to the work queue.
+ *
+ * A connection has at most one request with the workers at a time. Pipelined
+ * requests stay buffered here and go out one by one as replies come back, so
+ * they execute, and are answered, in the order they were sent.
+ */
+bool EventLoop::dispatch(Connection& conn) {
+    if (conn.request_pending || conn.close_after_write || conn.input.empty()) return true;
+
+    if (conn.mode == WireMode::Unknown) {
+        unsigned char first = conn.input[0];
+        conn.mode = (first == '{' || first == '[' || isspace(first)) ? WireMode::Legacy : WireMode::Framed;
+    }
+
+    std::string request_data;
+    uint32_t request_id = 0;
+    if (conn.mode == WireMode::Binary) {
+        if (conn.input.size() < BINARY_HEADER_SIZE) return true;
+        BinaryHeader header;
+        if (!decode_binary_header(conn.input.data(), header)) return respond_error(conn, "Bad frame header");
+        request_id = header.request_id;
+        if (header.body_length > m_config.max_request_bytes) return respond_error(conn, "Request too large", request_id);
+        size_t frame_size = BINARY_HEADER_SIZE + header.body_length;
+        if (conn.input.size() < frame_size) return true;
+        // The whole frame goes to the worker; it re-reads the header.
+        request_data = conn.input.substr(0, frame_size);
+        conn.input.erase(0, frame_size);
+    } else if (conn.mode == WireMode::Framed) {
+        if (conn.input.size() < FRAME_HEADER_SIZE) return true;
+        uint32_t length = read_frame_length(conn.input);
+        if (length > m_config.max_request_bytes) {
+            return respond_error(conn, "Request too large");
+        }
+        if (conn.input.size() < FRAME_HEADER_SIZE + length) return true;
+        request_data = conn.input.substr(FRAME_HEADER_SIZE, length);
+        conn.input.erase(0, FRAME_HEADER_SIZE + length);
     } else {
-        // If recv returns 0, the client has closed the connection.
-        // If it returns -1, an error occurred.
-        std::cerr << "Failed to read from socket or client disconnected. Closing socket " << client_socket << std::endl;
-        close(client_socket);
+        size_t request_end = find_request_end(conn.input);
+        if (request_end == 0) {
+            if (conn.read_paused) return respond_error(conn, "Request too large");
+            return true;
+        }
+        request_data = conn.input.substr(0, request_end);
+        conn.input.erase(0, request_end);
+    }
+
+    ClientRequest req;
+    req.client_socket = conn.fd;
+    req.request_data = std::move(request_data);
+    req.remote_addr = conn.remote_addr;
+    req.enqueued_at = std::chrono::steady_clock::now();
+    req.loop_id = m_id;
+    req.connection_id = conn.id;
+    req.binary = (conn.mode == WireMode::Binary);
+    classify_request(req);
+
+    if (g_draining) {
+        return respond_error(conn, "Server is shutting down", request_id);
+    }
+    if (!m_queue.push(std::move(req))) {
+        g_server_metrics.rejected_queue_full++;
+        return respond_error(conn, "Server busy, try again later", request_id);
     }
-    // This thread's job is done. The worker thread will handle the response and closing the socket on success.
+    g_server_metrics.in_flight++;
+    conn.request_pending = true;
+    g_server_metrics.queue_depth = m_queue.size();
+    return true;
 }
 
 /**
- * @brief Starts the main server loop.
+ * @brief Queues a reply in the connection's wire format and starts writing it.
  *
- * This function sets up the main listening socket and enters an infinite loop
- * to accept new client connections. For each new connection, it spawns a
- * detached thread to handle the client's request.
+ * Legacy connections always close after their single reply. A segment, if
+ * any, is sent straight from the container file right after `data`.
+ */
+bool EventLoop::respond(Connection& conn, const std::string& data, bool close_after, FileSegment&& segment) {
+    if (conn.mode == WireMode::Framed) {
+        append_frame(conn, data);
+    } else if (conn.mode == WireMode::Binary) {
+        append_output(conn, data);  // Already a complete frame
+    } else {
+        append_output(conn, data);
+        close_after = true;
+    }
+    if (segment.length > 0) {
+        conn.output.back().file = std::move(segment);
+    } else {
+        release_segment(segment);
+    }
+    if (close_after) conn.close_after_write = true;
+    return flush(conn);
+}
+
+/**
+ * @brief Sends an error raised by the loop itself and closes the connection.
  */
-void start_server() {
-    // 1. Create the server socket
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+bool EventLoop::respond_error(Connection& conn, const std::string& message, uint32_t request_id) {
+    if (conn.mode == WireMode::Binary) {
+        return respond(conn, encode_binary_error(request_id, OFS_ERROR_INVALID_OPERATION, message), true);
+    }
+    return respond(conn, error_text(message), true);
+}
+
+/**
+ * @brief Closes a connection whose client has gone once nothing is left to answer.
+ */
+bool EventLoop::close_if_idle(Connection& conn) {
+    if (!conn.peer_closed || conn.request_pending || conn.close_after_write) return true;
+    conn.close_after_write = true;
+    return flush(conn);
+}
+
+/**
+ * @brief Writes as much pending output as the socket accepts.
+ *
+ * File segments go out with sendfile(), so their content never enters user
+ * space. On EAGAIN the rest waits for the next EPOLLOUT edge.
+ */
+bool EventLoop::flush(Connection& conn) {
+    while (!conn.output.empty()) {
+        OutputChunk& chunk = conn.output.front();
+        ssize_t n;
+        if (conn.output_offset < chunk.bytes.size()) {
+            n = send(conn.fd, chunk.bytes.data() + conn.output_offset,
+                     chunk.bytes.size() - conn.output_offset, MSG_NOSIGNAL);
+            if (n > 0) { conn.output_offset += n; continue; }
+        } else if (chunk.file.length > 0) {
+            off_t file_offset = (off_t)chunk.file.offset;
+            n = sendfile(conn.fd, chunk.file.fd, &file_offset, chunk.file.length);
+            if (n > 0) {
+                chunk.file.offset += n;
+                chunk.file.length -= n;
+                continue;
+            }
+        } else {
+            release_segment(chunk.file);
+            conn.output.pop_front();
+            conn.output_offset = 0;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        close_connection(conn);
+        return false;
+    }
+    if (conn.close_after_write) {
+        close_connection(conn);
+        return false;
+    }
+    return true;
+}
+
+void EventLoop::close_connection(Connection& conn) {
+    for (OutputChunk& chunk : conn.output) release_segment(chunk.file);
+    close(conn.fd);  // Also removes it from the epoll set
+    m_connections.erase(conn.fd);
+    g_server_metrics.active_connections--;
+}
+
+/**
+ * @brief Called from worker threads. Queues a reply and wakes the loop.
+ */
+void EventLoop::post(Completion&& completion) {
+    {
+        std::lock_guard<std::mutex> lock(m_completion_mutex);
+        m_completions.push_back(std::move(completion));
+    }
+    wake();
+}
+
+void EventLoop::wake() {
+    uint64_t one = 1;
+    ssize_t ignored = write(m_wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+void EventLoop::close_listeners() {
+    for (int* fd : {&m_listen_fd, &m_binary_listen_fd}) {
+        if (*fd < 0) continue;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, *fd, nullptr);
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+void EventLoop::drain_completions() {
+    uint64_t counter;
+    while (read(m_wake_fd, &counter, sizeof(counter)) > 0) {}
+
+    std::vector<Completion> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_completion_mutex);
+        ready.swap(m_completions);
+    }
+    for (Completion& completion : ready) {
+        g_server_metrics.in_flight--;
+        auto it = m_connections.find(completion.fd);
+        // The client may have gone away and the fd been reused meanwhile.
+        if (it == m_connections.end() || it->second.id != completion.connection_id) {
+            release_segment(completion.segment);
+            continue;
+        }
+        Connection& conn = it->second;
+        conn.request_pending = false;
+        if (!respond(conn, completion.data, false, std::move(completion.segment))) continue;
+        if (conn.read_paused) {
+            handle_readable(conn);  // Resumes reading and dispatches
+        } else if (dispatch(conn)) {
+            close_if_idle(conn);
+        }
+    }
+}
+
+/**
+ * @brief Runs one JSON request as a coroutine.
+ *
+ * The worker that starts it returns to the queue as soon as the request
+ * waits on disk; the reply is posted by whichever thread finishes it.
+ */
+static task<void> serve_json_request(ClientRequest req) {
+    // Nothing may escape: an exception leaving a spawned coroutine terminates
+    // the process.
+    std::string reply;
+    try {
+        json request = json::parse(req.request_data);
+        long retry_ms = check_rate_limit(req.remote_addr, request);
+        json response;
+        if (retry_ms > 0) {
+            response = {{"status", "error"}, {"error_message", "Rate limit exceeded"}, {"retry_after_ms", retry_ms}};
+        } else {
+            response = co_await execute_request_async(std::move(request));
+        }
+        reply = response_text(response);
+    } catch (std::exception& e) {
+        reply = error_text(e.what());
+    } catch (...) {
+        reply = error_text("Internal error");
+    }
+    g_server_metrics.processed++;
+    g_event_loops[req.loop_id]->post({req.client_socket, req.connection_id, std::move(reply), FileSegment()});
+}
+
+/**
+ * @brief Consumer side of the pipeline.
+ *
+ * Pops requests in FIFO order, drops the ones that waited longer than
+ * queue_timeout, executes the rest and posts the reply to the loop that
+ * owns the connection. JSON requests are handed to serve_json_request, so
+ * a worker is never parked on a JSON request's disk I/O.
+ */
+void worker_loop(RequestQueue& queue, const ServerConfig& config) {
+    while (true) {
+        ClientRequest req = queue.pop();
+        g_server_metrics.queue_depth = queue.size();
+
+        uint64_t wait_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - req.enqueued_at).count();
+        record_latency(req.operation, Stage::QueueWait, wait_ns);
+        uint64_t wait_us = wait_ns / 1000;
+        g_server_metrics.total_wait_us += wait_us;
+        uint64_t previous_max = g_server_metrics.max_wait_us;
+        while (wait_us > previous_max && !g_server_metrics.max_wait_us.compare_exchange_weak(previous_max, wait_us)) {}
+
+        std::string reply;
+        FileSegment segment;
+        if (wait_us > (uint64_t)config.queue_timeout_seconds * 1000000) {
+            g_server_metrics.timed_out++;
+            if (req.binary) {
+                BinaryHeader header;
+                decode_binary_header(req.request_data.data(), header);
+                reply = encode_binary_error(header.request_id, OFS_ERROR_INVALID_OPERATION, "Request timed out in queue");
+            } else {
+                reply = error_text("Request timed out in queue");
+            }
+        } else if (req.binary) {
+            reply = execute_binary_request(req.request_data, req.remote_addr, segment);
+            g_server_metrics.processed++;
+        } else {
+            spawn(serve_json_request(std::move(req)));
+            continue;
+        }
+        g_event_loops[req.loop_id]->post({req.client_socket, req.connection_id, std::move(reply), std::move(segment)});
+    }
+}
+
+/**
+ * @brief Creates a non-blocking SO_REUSEPORT listener on a port.
+ * @return The socket, or -1 on failure.
+ */
+static int create_listener(int port) {
+    int server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (server_fd == -1) {
-        std::cerr << "FATAL: Could not create server socket." << std::endl;
-        return;
+        LOG_ERROR("Could not create server socket").kv("errno", errno);
+        return -1;
     }
+    int enable = 1;
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
 
-    // 2. Define the server address
     sockaddr_in server_addr{};
     server_addr.sin_family = AF_INET;
     server_addr.sin_addr.s_addr = INADDR_ANY; // Listen on all available interfaces
-    server_addr.sin_port = htons(8080);      // Listen on port 8080
+    server_addr.sin_port = htons(port);
 
-    // 3. Bind the socket to the address and port
     if (bind(server_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        std::cerr << "FATAL: Bind failed. Port may be in use." << std::endl;
+        LOG_ERROR("Bind failed; port may be in use").kv("port", port);
         close(server_fd);
-        return;
+        return -1;
     }
-    
-    // 4. Start listening for incoming connections
-    if (listen(server_fd, 10) < 0) { // 10 is the max length of the pending connections queue
-        std::cerr << "FATAL: Listen failed." << std::endl;
+    if (listen(server_fd, SOMAXCONN) < 0) {
+        LOG_ERROR("Listen failed").kv("port", port).kv("errno", errno);
         close(server_fd);
-        return;
+        return -1;
     }
-    
-    std::cout << "Server is active and listening on port 8080..." << std::endl;
+    return server_fd;
+}
 
-    // 5. Main accept loop
-    while (true) {
-        int client_socket = accept(server_fd, nullptr, nullptr);
-        if (client_socket < 0) {
-            std::cerr << "Error: Accept call failed." << std::endl;
-            continue; // Continue listening for other connections
+/**
+ * @brief Starts the socket server.
+ *
+ * Raises the open-file limit, starts the worker pool and one event loop per
+ * core (or config.event_loops), each with its own listeners on the JSON
+ * and binary ports. The calling thread runs the first loop and does not return.
+ */
+void start_server(const ServerConfig& config) {
+    rlimit file_limit{};
+    if (getrlimit(RLIMIT_NOFILE, &file_limit) == 0 && file_limit.rlim_cur < file_limit.rlim_max) {
+        file_limit.rlim_cur = file_limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &file_limit);
+    }
+
+    int loop_count = config.event_loops > 0 ? config.event_loops : (int)std::thread::hardware_concurrency();
+    if (loop_count < 1) loop_count = 1;
+
+    // The queue, loops and config live for the rest of the process.
+    static RequestQueue queue(config.queue_capacity);
+    static const ServerConfig server_config = config;
+
+    std::vector<EventLoop*> loops;
+    for (int i = 0; i < loop_count; ++i) {
+        int listen_fd = create_listener(server_config.port);
+        int binary_listen_fd = server_config.binary_port > 0 ? create_listener(server_config.binary_port) : -1;
+        if (listen_fd < 0) {
+            if (binary_listen_fd >= 0) close(binary_listen_fd);
+            break;  // Run with the loops we have
         }
-        
-        std::cout << "Connection accepted. Creating a handler thread for the new client." << std::endl;
+        loops.push_back(new EventLoop(i, listen_fd, binary_listen_fd, queue, server_config));
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_start_mutex);
+        g_event_loops = std::move(loops);
+        g_start_finished = true;
+    }
+    g_start_done.notify_all();
+    if (g_event_loops.empty()) return;
+
+    for (int i = 0; i < server_config.worker_count; ++i) {
+        std::thread(worker_loop, std::ref(queue), std::cref(server_config)).detach();
+    }
+    for (size_t i = 1; i < g_event_loops.size(); ++i) {
+        std::thread(&EventLoop::run, g_event_loops[i]).detach();
+    }
+
+    LOG_INFO("Socket server listening")
+        .kv("port", server_config.port)
+        .kv("binary_port", server_config.binary_port)
+        .kv("event_loops", g_event_loops.size())
+        .kv("workers", server_config.worker_count);
+    g_event_loops[0]->run();
+}
 
-        // Create a new thread to handle the client and detach it.
-        // Detaching allows the thread to run independently, and the main
-        // loop can immediately go back to waiting for another connection.
-        std::thread(client_handler, client_socket).detach();
+bool stop_server(std::chrono::milliseconds deadline) {
+    g_draining = true;
+    auto give_up = std::chrono::steady_clock::now() + deadline;
+    {
+        // A stop during startup waits for the loops to be published. A loop
+        // started after g_draining was set still closes its listeners once
+        // woken below.
+        std::unique_lock<std::mutex> lock(g_start_mutex);
+        if (!g_start_done.wait_until(lock, give_up, [] { return g_start_finished; })) return false;
     }
+    for (EventLoop* loop : g_event_loops) loop->wake();
 
-    // This part is unreachable in this simple server, but good practice
-    close(server_fd);
-}
\ No newline at end of file
+    while (g_server_metrics.in_flight > 0 && std::chrono::steady_clock::now() < give_up) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return g_server_metrics.in_flight == 0;
+}
@@ -0,0 +1,30 @@
+#include "../../include/LockManager.h"
+#include <algorithm>
+
+LockManager::Guard::Guard(std::vector<std::shared_mutex*> locked, bool exclusive)
+    : m_locked(std::move(locked)), m_exclusive(exclusive) {}
+
+LockManager::Guard::Guard(Guard&& other) noexcept
+    : m_locked(std::move(other.m_locked)), m_exclusive(other.m_exclusive) {
+    other.m_locked.clear();
+}
+
+LockManager::Guard::~Guard() {
+    for (auto it = m_locked.rbegin(); it != m_locked.rend(); ++it) {
+        if (m_exclusive) { (*it)->unlock(); } else { (*it)->unlock_shared(); }
+    }
+}
+
+LockManager::Guard LockManager::lock_entries(const std::vector<uint32_t>& entries, bool exclusive) {
+    std::vector<uint32_t> stripes;
+    for (uint32_t entry : entries) { stripes.push_back(entry % STRIPE_COUNT); }
+    std::sort(stripes.begin(), stripes.end());
+    stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+
+    std::vector<std::shared_mutex*> locked;
+    for (uint32_t stripe : stripes) {
+        if (exclusive) { m_stripes[stripe].lock(); } else { m_stripes[stripe].lock_shared(); }
+        locked.push_back(&m_stripes[stripe]);
+    }
+    return Guard(std::move(locked), exclusive);
+}
@@ -0,0 +1,64 @@
+#include "../../include/RateLimiter.h"
+#include <functional>
+#include <algorithm>
+#include <cmath>
+
+RateLimiter::RateLimiter(RateLimitPolicy read_policy, RateLimitPolicy write_policy)
+    : m_read_policy(read_policy), m_write_policy(write_policy) {}
+
+RateLimiter::Shard& RateLimiter::shard_for(const std::string& key) {
+    return m_shards[std::hash<std::string>{}(key) % SHARD_COUNT];
+}
+
+void RateLimiter::refill(TokenBucket& bucket, const RateLimitPolicy& policy, std::chrono::steady_clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - bucket.last_refill).count();
+    bucket.tokens = std::min(policy.capacity, bucket.tokens + elapsed * policy.refill_per_second);
+    bucket.last_refill = now;
+}
+
+// Drops buckets that have been idle long enough to be full again; forgetting
+// them is indistinguishable from keeping them.
+void RateLimiter::prune(Shard& shard, std::chrono::steady_clock::time_point now) {
+    double read_full = m_read_policy.capacity / m_read_policy.refill_per_second;
+    double write_full = m_write_policy.capacity / m_write_policy.refill_per_second;
+    for (auto it = shard.buckets.begin(); it != shard.buckets.end();) {
+        double read_idle = std::chrono::duration<double>(now - it->second.read.last_refill).count();
+        double write_idle = std::chrono::duration<double>(now - it->second.write.last_refill).count();
+        if (read_idle >= read_full && write_idle >= write_full) {
+            it = shard.buckets.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+long RateLimiter::try_acquire(const std::string& key, bool is_write) {
+    auto now = std::chrono::steady_clock::now();
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.buckets.size() >= PRUNE_THRESHOLD) { prune(shard, now); }
+
+    auto it = shard.buckets.find(key);
+    if (it == shard.buckets.end()) {
+        BucketPair fresh = {{m_read_policy.capacity, now}, {m_write_policy.capacity, now}};
+        it = shard.buckets.emplace(key, fresh).first;
+    }
+    TokenBucket& bucket = is_write ? it->second.write : it->second.read;
+    const RateLimitPolicy& policy = is_write ? m_write_policy : m_read_policy;
+    refill(bucket, policy, now);
+    if (bucket.tokens >= 1.0) {
+        bucket.tokens -= 1.0;
+        return 0;
+    }
+    return std::max(1L, (long)std::ceil((1.0 - bucket.tokens) / policy.refill_per_second * 1000.0));
+}
+
+void RateLimiter::refund(const std::string& key, bool is_write) {
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.buckets.find(key);
+    if (it == shard.buckets.end()) { return; }
+    TokenBucket& bucket = is_write ? it->second.write : it->second.read;
+    const RateLimitPolicy& policy = is_write ? m_write_policy : m_read_policy;
+    bucket.tokens = std::min(policy.capacity, bucket.tokens + 1.0);
+}
@@ -1,15 +1,159 @@
 #include "../../include/RequestQueue.h"
+#include <thread>
+#include <climits>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
-void RequestQueue::push(ClientRequest request) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_queue.push(request);
-    m_cond.notify_one();
+static void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+RequestQueue::RequestQueue(size_t capacity) : m_capacity(capacity), m_scheduled(0) {
+    size_t rounded = 2;
+    while (rounded < capacity) { rounded <<= 1; }
+    m_slots.reset(new Slot[rounded]);
+    m_mask = rounded - 1;
+    for (size_t i = 0; i < rounded; ++i) {
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    m_enqueue_pos.store(0, std::memory_order_relaxed);
+    m_dequeue_pos.store(0, std::memory_order_relaxed);
+    m_futex_word.store(0, std::memory_order_relaxed);
+    m_sleepers.store(0, std::memory_order_relaxed);
+}
+
+bool RequestQueue::push(ClientRequest&& request) {
+    if (size() >= m_capacity) { return false; }
+    Slot* slot;
+    size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    while (true) {
+        slot = &m_slots[pos & m_mask];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+        } else if (diff < 0) {
+            return false;  // Full: the slot still holds an item from one lap ago
+        } else {
+            pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    slot->value = std::move(request);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    // Pairs with the increment of m_sleepers in pop(): either the consumer
+    // sees the new item on its re-check, or we see it as a sleeper here.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleepers.load(std::memory_order_relaxed) > 0) { wake_consumer(); }
+    return true;
+}
+
+// Takes the oldest request out of the ring.
+bool RequestQueue::pop_arrival(ClientRequest& request) {
+    Slot* slot;
+    size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    while (true) {
+        slot = &m_slots[pos & m_mask];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+        } else if (diff < 0) {
+            return false;  // Empty
+        } else {
+            pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    request = std::move(slot->value);
+    slot->sequence.store(pos + m_mask + 1, std::memory_order_release);
+    return true;
+}
+
+// Caller holds m_schedule_mutex.
+void RequestQueue::schedule(ClientRequest&& request) {
+    if (m_flows.size() >= FLOW_PRUNE_THRESHOLD) { prune_flows(); }
+    std::string key(1, (char)request.priority);
+    key += request.tenant;
+    Flow& flow = m_flows[key];
+    double start = std::max(m_virtual_time, flow.last_finish);
+    double finish = start + (double)std::max<uint32_t>(request.cost, 1) / REQUEST_CLASS_WEIGHTS[(size_t)request.priority];
+    flow.last_finish = finish;
+    flow.waiting.push_back({std::move(request), start, finish});
+    if (flow.waiting.size() == 1) { m_ready.push({start, m_arrivals, &flow}); }
+    m_arrivals++;
+    m_scheduled.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Drops idle flows that are owed no delay: a new request for them would be
+// tagged with the virtual time either way.
+void RequestQueue::prune_flows() {
+    for (auto it = m_flows.begin(); it != m_flows.end();) {
+        if (it->second.waiting.empty() && it->second.last_finish <= m_virtual_time) {
+            it = m_flows.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool RequestQueue::try_pop(ClientRequest& request) {
+    if (size() == 0) { return false; }
+    {
+        std::lock_guard<std::mutex> lock(m_schedule_mutex);
+        ClientRequest arrival;
+        while (pop_arrival(arrival)) { schedule(std::move(arrival)); }
+        if (m_ready.empty()) { return false; }
+
+        Flow* flow = m_ready.top().flow;
+        m_ready.pop();
+        Tagged& next = flow->waiting.front();
+        m_virtual_time = next.start;
+        request = std::move(next.request);
+        flow->waiting.pop_front();
+        if (!flow->waiting.empty()) { m_ready.push({flow->waiting.front().start, m_arrivals++, flow}); }
+        m_scheduled.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // A consumer that checked while this one was moving arrivals out of the
+    // ring may have seen an empty queue and parked; wake it for what is left.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_scheduled.load(std::memory_order_relaxed) > 0 && m_sleepers.load(std::memory_order_relaxed) > 0) { wake_consumer(); }
+    return true;
 }
 
 ClientRequest RequestQueue::pop() {
-    std::unique_lock<std::mutex> lock(m_mutex);
-    m_cond.wait(lock, [this]{ return !m_queue.empty(); });
-    ClientRequest request = m_queue.front();
-    m_queue.pop();
-    return request;
-}
\ No newline at end of file
+    ClientRequest request;
+    while (true) {
+        for (int i = 0; i < SPIN_ATTEMPTS; ++i) {
+            if (try_pop(request)) { return request; }
+            cpu_relax();
+        }
+
+        uint32_t seen = m_futex_word.load(std::memory_order_acquire);
+        m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+        if (try_pop(request)) {
+            m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+            return request;
+        }
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_futex_word), FUTEX_WAIT_PRIVATE, seen, nullptr, nullptr, 0);
+        m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+size_t RequestQueue::size() const {
+    size_t enqueued = m_enqueue_pos.load(std::memory_order_relaxed);
+    size_t dequeued = m_dequeue_pos.load(std::memory_order_relaxed);
+    size_t arriving = enqueued > dequeued ? enqueued - dequeued : 0;
+    return arriving + m_scheduled.load(std::memory_order_relaxed);
+}
+
+void RequestQueue::wake_consumer() {
+    m_futex_word.fetch_add(1, std::memory_order_release);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_futex_word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
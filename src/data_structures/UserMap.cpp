@@ -48,4 +48,18 @@ UserInfo* user_map_get(UserMap* map, const std::string& key) {
         current = current->next;
     }
     return nullptr; // User not found
-}
\ No newline at end of file
+}
+
+void user_map_remove(UserMap* map, const std::string& key) {
+    unsigned int index = hash_key(key, map->size);
+    UserMapNode** link = &map->buckets[index];
+    while (*link != nullptr) {
+        if ((*link)->key == key) {
+            UserMapNode* to_delete = *link;
+            *link = to_delete->next; // Unlink the node from its chain
+            delete to_delete;
+            return;
+        }
+        link = &(*link)->next;
+    }
+}